@@ -17,6 +17,7 @@
 #include "model/rategamma.h"
 #include "gsl/mygsl.h"
 #include "utils/gzstream.h"
+#include "utils/asyncstream.h"
 #include "utils/timeutil.h" //for getRealTime()
 #include "utils/progress.h" //for progress_display
 #include "alignmentsummary.h"
@@ -3073,7 +3074,7 @@ void Alignment::printNexus(ostream &out, bool append, const char *aln_site_list,
 void Alignment::printAlignment(InputType format, const char *file_name, bool append, const char *aln_site_list,
                                int exclude_sites, const char *ref_seq_name) {
     try {
-        ofstream out;
+        AsyncOutputStream out;
         out.exceptions(ios::failbit | ios::badbit);
         
         if (append)
@@ -3681,24 +3682,32 @@ void Alignment::createBootstrapAlignment(Alignment *aln, IntVector* pattern_freq
 	IntVector site_vec;
     if (!spec) {
 		// standard bootstrap
+        // the patterns of aln are distinct, so each resampled pattern is copied once
+        // (incl. its constant-site information) instead of hashing it for every resampled site
         int added_sites = 0;
         IntVector sample;
         random_resampling(nsite, sample);
+        IntVector boot_ptn_id(aln->getNPattern(), -1);
         for (size_t site = 0; site < nsite; ++site) {
-            for (int rep = 0; rep < sample[site]; ++rep) {
-                int ptn_id = aln->getPatternID(site);
-                Pattern pat = aln->at(ptn_id);
-                int nptn = getNPattern();
-                addPattern(pat, added_sites);
-                if (!aln->site_state_freq.empty() && getNPattern() > nptn) {
+            if (sample[site] == 0)
+                continue;
+            int ptn_id = aln->getPatternID(site);
+            if (boot_ptn_id[ptn_id] < 0) {
+                boot_ptn_id[ptn_id] = getNPattern();
+                push_back(aln->at(ptn_id));
+                back().frequency = 0;
+                pattern_index[back()] = boot_ptn_id[ptn_id];
+                if (!aln->site_state_freq.empty()) {
                     // a new pattern is added, copy state frequency vector
                     double *state_freq = new double[num_states];
                     memcpy(state_freq, aln->site_state_freq[ptn_id], num_states*sizeof(double));
                     site_state_freq.push_back(state_freq);
                 }
-                if (pattern_freq) ((*pattern_freq)[ptn_id])++;
-                added_sites++;
             }
+            at(boot_ptn_id[ptn_id]).frequency += sample[site];
+            for (int rep = 0; rep < sample[site]; ++rep)
+                site_pattern[added_sites++] = boot_ptn_id[ptn_id];
+            if (pattern_freq) ((*pattern_freq)[ptn_id]) += sample[site];
         }
         if (added_sites < nsite)
             site_pattern.resize(added_sites);
@@ -4256,6 +4265,113 @@ double Alignment::computeJCDist(int seq1, int seq2) {
     return computeJCDistanceFromObservedDistance(obs_dist);
 }
 
+static inline int popcount64(uint64_t x) {
+#if defined (__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+void Alignment::computeDistMatrix(double *dist_mat, bool jc_correction) {
+    size_t nseqs = getNSeq();
+    int nplanes = 1;
+    while ((1 << nplanes) < num_states)
+        nplanes++;
+    // words of a sequence: the known-state plane followed by the state planes
+    size_t word_stride = nplanes + 1;
+
+    // variant patterns sorted by frequency, each run of equal frequency starts a new word,
+    // such that the popcounts of a word are weighted by a single frequency
+    vector<int> ptns;
+    for (size_t ptn = 0; ptn < size(); ptn++)
+        if (!at(ptn).isConst())
+            ptns.push_back(ptn);
+    vector<pair<int, int> > freq_ptns;
+    freq_ptns.reserve(ptns.size());
+    for (size_t i = 0; i < ptns.size(); i++)
+        freq_ptns.push_back(make_pair(at(ptns[i]).frequency, ptns[i]));
+    sort(freq_ptns.begin(), freq_ptns.end());
+    vector<int64_t> word_freq;
+    vector<size_t> word_start; // index into freq_ptns of the first pattern of a word
+    for (size_t i = 0; i < freq_ptns.size(); i++) {
+        if (word_start.empty() || i - word_start.back() == 64 || freq_ptns[i].first != word_freq.back()) {
+            word_start.push_back(i);
+            word_freq.push_back(freq_ptns[i].first);
+        }
+    }
+    size_t nwords = word_freq.size();
+    word_start.push_back(freq_ptns.size());
+
+    vector<uint64_t> bits(nseqs * nwords * word_stride, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (size_t word = 0; word < nwords; word++) {
+        for (size_t i = word_start[word]; i < word_start[word+1]; i++) {
+            Pattern &pat = at(freq_ptns[i].second);
+            uint64_t bit = (uint64_t)1 << (i - word_start[word]);
+            for (size_t seq = 0; seq < nseqs; seq++) {
+                int state = convertPomoState(pat[seq]);
+                if (state >= num_states)
+                    continue;
+                uint64_t *seq_word = &bits[(seq * nwords + word) * word_stride];
+                seq_word[0] |= bit;
+                for (int plane = 0; plane < nplanes; plane++)
+                    if (state & (1 << plane))
+                        seq_word[plane+1] |= bit;
+            }
+        }
+    }
+
+    // tiles of sequence pairs, such that the bit-sliced sequences of a tile stay in cache
+    const size_t TILE = 16;
+    size_t ntiles = (nseqs + TILE - 1) / TILE;
+    vector<pair<size_t, size_t> > tiles;
+    for (size_t tile1 = 0; tile1 < ntiles; tile1++)
+        for (size_t tile2 = tile1; tile2 < ntiles; tile2++)
+            tiles.push_back(make_pair(tile1, tile2));
+    int64_t num_const_sites = getNSite() - num_variant_sites;
+    const uint64_t *all_bits = bits.data();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (size_t tile = 0; tile < tiles.size(); tile++) {
+        size_t seq1_end = min((tiles[tile].first+1) * TILE, nseqs);
+        size_t seq2_end = min((tiles[tile].second+1) * TILE, nseqs);
+        for (size_t seq1 = tiles[tile].first * TILE; seq1 < seq1_end; seq1++) {
+            size_t seq2 = max(tiles[tile].second * TILE, seq1 + 1);
+            for (; seq2 < seq2_end; seq2++) {
+                double &dist = dist_mat[seq1 * nseqs + seq2];
+                if (dist != 0.0)
+                    continue;
+                const uint64_t *a = all_bits + seq1 * nwords * word_stride;
+                const uint64_t *b = all_bits + seq2 * nwords * word_stride;
+                int64_t total_pos = num_const_sites, diff_pos = 0;
+                for (size_t word = 0; word < nwords; word++, a += word_stride, b += word_stride) {
+                    uint64_t known = a[0] & b[0];
+                    uint64_t diff = 0;
+                    for (size_t plane = 1; plane < word_stride; plane++)
+                        diff |= a[plane] ^ b[plane];
+                    diff &= known;
+                    total_pos += word_freq[word] * popcount64(known);
+                    diff_pos += word_freq[word] * popcount64(diff);
+                }
+                if (!total_pos)
+                    dist = MAX_GENETIC_DIST; // no overlap between two sequences
+                else
+                    dist = ((double)diff_pos) / total_pos;
+                if (jc_correction)
+                    dist = computeJCDistanceFromObservedDistance(dist);
+            }
+        }
+    }
+}
+
 void Alignment::printDist(ostream &out, double *dist_mat) {
     size_t nseqs = getNSeq();
     int max_len = getMaxSeqNameLength();
@@ -693,6 +693,18 @@ public:
      */
     double computeJCDist(int seq1, int seq2);
 
+    /**
+            compute observed or Jukes-Cantor corrected distances between all pairs of sequences.
+            Sequences are bit-sliced over the variant patterns (one bit plane marking known
+            states and ceil(log2(num_states)) planes for the state), so that a pair of sequences
+            is compared 64 patterns at a time by popcounts. Gives the same distances as
+            computeObsDist() and computeJCDist().
+            @param dist_mat (OUT) nseq x nseq distance matrix, only the upper triangle is
+            written and entries that are already non-zero are kept
+            @param jc_correction TRUE for Jukes-Cantor corrected distances
+     */
+    void computeDistMatrix(double *dist_mat, bool jc_correction);
+
     /**
             abstract function to compute the distance between 2 sequences. The default return
             Juke-Cantor corrected distance.
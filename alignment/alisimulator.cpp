@@ -750,7 +750,15 @@ void AliSimulator::simulateSeqsForTree(map<string,string> input_msa, string outp
     extractRatesJMatrix(model);
     
     // simulate Sequences
+    site_insertion_order.clear();
     simulateSeqs(sequence_length, model, trans_matrix, tree->MTree::root, tree->MTree::root, *out, state_mapping, input_msa);
+    
+    // insert gaps into the sequences simulated before the later insertion events
+    if (site_insertion_order.size() > 0)
+    {
+        insertGapsForInsertionEvents(tree->MTree::root, tree->MTree::root);
+        site_insertion_order.clear();
+    }
         
     // close the file if neccessary
     if (output_filepath.length() > 0)
@@ -794,6 +802,9 @@ void AliSimulator::simulateSeqs(int &sequence_length, ModelSubst *model, double
         if (node->num_children_done_simulation >= (node->neighbors.size() - 1))
             node->num_children_done_simulation = 0;
         
+        // insert gaps for the sites inserted while simulating the previous subtrees
+        insertGapsForInsertionEvents(node);
+        
         // select the appropriate simulation method
         SIMULATION_METHOD simulation_method = RATE_MATRIX;
         if (((*it)->length * params->alisim_branch_scale > params->alisim_simulation_thresh && !(model->isMixture() && params->alisim_mixture_at_sub_level))
@@ -1708,7 +1719,7 @@ void AliSimulator::extractRatesJMatrix(ModelSubst *model)
 /**
     initialize variables for Rate_matrix approach: total_sub_rate, accumulated_rates, num_gaps
 */
-void AliSimulator::initVariables4RateMatrix(double &total_sub_rate, int &num_gaps, vector<double> &sub_rate_by_site, vector<short int> sequence)
+void AliSimulator::initVariables4RateMatrix(double &total_sub_rate, int &num_gaps, vector<double> &sub_rate_by_site, vector<short int> &sequence)
 {
     // initialize variables
     int sequence_length = sequence.size();
@@ -1764,8 +1775,9 @@ void AliSimulator::handleIndels(ModelSubst *model, int &sequence_length, Node *n
     double total_del_rate = params->alisim_deletion_ratio*(sequence_length - 1 - num_gaps + computeMeanDelSize(sequence_length));
     double total_event_rate = total_sub_rate + total_ins_rate + total_del_rate;
     
-    indel_sequence = node->sequence;
-    index_mapping_by_jump_step.resize(sequence_length + 1, 0);
+    // the sequence is only copied into a rope when the first event occurs
+    IndelRope rope;
+    int initial_length = sequence_length;
     double branch_length = (*it)->length * params->alisim_branch_scale;
     while (branch_length > 0)
     {
@@ -1787,25 +1799,28 @@ void AliSimulator::handleIndels(ModelSubst *model, int &sequence_length, Node *n
             else if (random_num < total_ins_rate+total_del_rate)
                 event_type = DELETION;
             
+            if (rope.empty())
+                rope.build(node->sequence, simulation_method == RATE_MATRIX ? &sub_rate_by_site : NULL, STATE_UNKNOWN);
+            
             // process event
             int length_change = 0;
             switch (event_type)
             {
                 case INSERTION:
                 {
-                    length_change = handleInsertion(sequence_length, index_mapping_by_jump_step, indel_sequence, total_sub_rate, sub_rate_by_site, simulation_method);
+                    length_change = handleInsertion(sequence_length, rope, total_sub_rate, simulation_method);
                     break;
                 }
                 case DELETION:
                 {
-                    length_change = -handleDeletion(sequence_length, indel_sequence, total_sub_rate, sub_rate_by_site, simulation_method);
+                    length_change = -handleDeletion(sequence_length, rope, total_sub_rate, simulation_method);
                     break;
                 }
                 case SUBSTITUTION:
                 {
                     if (simulation_method == RATE_MATRIX)
                     {
-                        handleSubs(sequence_length, total_sub_rate, sub_rate_by_site, indel_sequence, model->getNMixtures());
+                        handleSubs(total_sub_rate, rope, model->getNMixtures());
                     }
                     break;
                 }
@@ -1824,11 +1839,43 @@ void AliSimulator::handleIndels(ModelSubst *model, int &sequence_length, Node *n
 
     }
     
-    // if insertion events occur -> insert gaps to other nodes
-    if (index_mapping_by_jump_step[index_mapping_by_jump_step.size() - 1]>0)
+    index_mapping_by_jump_step.assign(initial_length + 1, 0);
+    if (rope.empty())
+    {
+        indel_sequence = node->sequence;
+        return;
+    }
+    vector<int> sources;
+    rope.exportSequence(indel_sequence, sources);
+    
+    // if insertion events occur -> reorder the site-specific information and record the order of the sites
+    if (sequence_length > initial_length)
     {
-        bool stop_inserting_gaps = false;
-        insertGapsForInsertionEvents(index_mapping_by_jump_step, (*it)->node->id, tree->root, tree->root, stop_inserting_gaps);
+        reorderSiteSpecificInfo(sources);
+        
+        if (site_insertion_order.empty())
+        {
+            site_insertion_order.resize(initial_length);
+            for (int i = 0; i < initial_length; i++)
+                site_insertion_order[i] = i;
+        }
+        IntVector new_insertion_order(sequence_length);
+        for (int i = 0; i < sequence_length; i++)
+        {
+            int source = sources[i];
+            if (source < initial_length)
+            {
+                new_insertion_order[i] = site_insertion_order[source];
+                index_mapping_by_jump_step[source] = i - source;
+            }
+            else
+                new_insertion_order[i] = source;
+        }
+        index_mapping_by_jump_step[initial_length] = sequence_length - initial_length;
+        site_insertion_order.swap(new_insertion_order);
+        
+        // the parent sequence is used to simulate the sequence of the child in the TRANS_PROB_MATRIX approach
+        insertGapsForInsertionEvents(node);
         
         // re-compute the switching param to switch between Rate matrix and Probability matrix
         computeSwitchingParam(sequence_length);
@@ -1839,62 +1886,85 @@ void AliSimulator::handleIndels(ModelSubst *model, int &sequence_length, Node *n
 *  insert a new sequence into the current sequence
 *
 */
-void AliSimulator::insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence)
+void AliSimulator::insertNewSequenceForInsertionEvent(IndelRope &indel_sequence, int position, vector<short int> &new_sequence)
 {
-    indel_sequence.insert(indel_sequence.begin()+position, new_sequence.begin(), new_sequence.end());
+    indel_sequence.insert(position, new_sequence);
+}
+
+/**
+    reorder the site-specific information according to the source indices of the sites after insertion events
+*/
+void AliSimulator::reorderSiteSpecificInfo(vector<int> &sources)
+{
+    int num_sources = *max_element(sources.begin(), sources.end()) + 1;
+    if (site_specific_model_index.size() == num_sources)
+    {
+        vector<short int> reordered(sources.size());
+        for (int i = 0; i < sources.size(); i++)
+            reordered[i] = site_specific_model_index[sources[i]];
+        site_specific_model_index.swap(reordered);
+    }
+    if (site_specific_rate_index.size() == num_sources)
+    {
+        vector<short int> reordered(sources.size());
+        for (int i = 0; i < sources.size(); i++)
+            reordered[i] = site_specific_rate_index[sources[i]];
+        site_specific_rate_index.swap(reordered);
+    }
+    if (site_specific_rates.size() == num_sources)
+    {
+        vector<double> reordered(sources.size());
+        for (int i = 0; i < sources.size(); i++)
+            reordered[i] = site_specific_rates[sources[i]];
+        site_specific_rates.swap(reordered);
+    }
+    if (site_to_patternID.size() == num_sources)
+    {
+        IntVector reordered(sources.size());
+        for (int i = 0; i < sources.size(); i++)
+            reordered[i] = site_to_patternID[sources[i]];
+        site_to_patternID.swap(reordered);
+    }
 }
 
 /**
-*  insert gaps into other nodes when processing Insertion Events
+*  insert gaps into the sequence of a node for the sites which were inserted in other lineages
+*  after the sequence had been simulated
 *
 */
-void AliSimulator::insertGapsForInsertionEvents(vector<int> index_mapping_by_jump_step, int stopping_node_id, Node *node, Node *dad, bool &stop_inserting_gaps)
+void AliSimulator::insertGapsForInsertionEvents(Node *node)
 {
-    // check to stop
-    if (stop_inserting_gaps)
+    // only insert gaps into not-empty and outdated sequences
+    int old_length = node->sequence.size();
+    if (old_length == 0 || old_length >= site_insertion_order.size())
         return;
     
-    // only insert gaps into not-empty node
-    if (node->sequence.size() > 0)
-    {
-        // resize the sequence with gaps
-        node->sequence.resize(index_mapping_by_jump_step.size() + index_mapping_by_jump_step[index_mapping_by_jump_step.size() - 1] - 1, STATE_UNKNOWN);
-        
-        // update sites to new positions
-        for (int i = index_mapping_by_jump_step.size() - 1 - 1; i >= 0; i--)
-        {
-            if (index_mapping_by_jump_step[i] > 0)
-            {
-                node->sequence[i + index_mapping_by_jump_step[i]] = node->sequence[i];
-                
-                // if (*it)->node->sequence[i] is not overrided, it should be a gap
-                node->sequence[i] = STATE_UNKNOWN;
-            }
-            else
-                break;
-        }
-        
-    }
+    // the sites of the old sequence are those inserted before it was simulated, in the same order
+    vector<short int> new_sequence(site_insertion_order.size(), STATE_UNKNOWN);
+    for (int i = 0, j = 0; i < site_insertion_order.size(); i++)
+        if (site_insertion_order[i] < old_length)
+            new_sequence[i] = node->sequence[j++];
+    node->sequence.swap(new_sequence);
+}
+
+/**
+*  insert gaps into the sequences of all nodes of a subtree for the sites inserted in other lineages
+*
+*/
+void AliSimulator::insertGapsForInsertionEvents(Node *node, Node *dad)
+{
+    insertGapsForInsertionEvents(node);
     
     // process its neighbors/children
     NeighborVec::iterator it;
-    FOR_NEIGHBOR(node, dad, it) {
-        // stop traversing the tree if reaching the stopping node
-        if ((*it)->node->id == stopping_node_id)
-        {
-            stop_inserting_gaps = true;
-            break;
-        }
-        
-        // browse 1-step deeper to the neighbor node
-        insertGapsForInsertionEvents(index_mapping_by_jump_step, stopping_node_id, (*it)->node, node, stop_inserting_gaps);
-    }
+    FOR_NEIGHBOR(node, dad, it)
+        insertGapsForInsertionEvents((*it)->node, node);
 }
 
 /**
     handle insertion events
 */
-int AliSimulator::handleInsertion(int &sequence_length, vector<int> &index_mapping_by_jump_step, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method)
+int AliSimulator::handleInsertion(int &sequence_length, IndelRope &indel_sequence, double &total_sub_rate, SIMULATION_METHOD simulation_method)
 {
     // Randomly select the position/site (from the set of all sites) where the insertion event occurs based on a uniform distribution between 0 and the current length of the sequence
     int position = selectValidPositionForIndels(sequence_length + 1, indel_sequence);
@@ -1915,20 +1985,21 @@ int AliSimulator::handleInsertion(int &sequence_length, vector<int> &index_mappi
     
     // insert new_sequence into the current sequence
     vector<short int> new_sequence = generateRandomSequence(length, false);
+    int first_source = indel_sequence.numSources();
     insertNewSequenceForInsertionEvent(indel_sequence, position, new_sequence);
     
-    // if RATE_MATRIX approach is used -> update total_sub_rate and sub_rate_by_site
+    // if RATE_MATRIX approach is used -> update total_sub_rate and the substitution rates of the inserted sites
     if (simulation_method == RATE_MATRIX)
     {
-        // update sub_rate_by_site of the inserted sites
         double sub_rate_change = 0;
-        sub_rate_by_site.insert(sub_rate_by_site.begin()+position, length, 0);
-        for (int i = position; i < position + length; i++)
+        int site = indel_sequence.getSite(position);
+        for (int i = first_source; i < first_source + length; i++, site = indel_sequence.getNextSite(site))
         {
             int mixture_index = site_specific_model_index.size() == 0? 0:site_specific_model_index[i];
             double site_rate = site_specific_rates.size() > 0?site_specific_rates[i]:1;
-            sub_rate_by_site[i] = site_rate*sub_rates[mixture_index*max_num_states + indel_sequence[i]];
-            sub_rate_change += sub_rate_by_site[i];
+            double sub_rate = site_rate*sub_rates[mixture_index*max_num_states + indel_sequence.getState(site)];
+            indel_sequence.setSite(site, indel_sequence.getState(site), sub_rate);
+            sub_rate_change += sub_rate;
         }
         
         // update total_sub_rate
@@ -1938,15 +2009,6 @@ int AliSimulator::handleInsertion(int &sequence_length, vector<int> &index_mappi
     // update the sequence_length
     sequence_length += length;
     
-    // update index_mapping_by_jump_step
-    for (int i = index_mapping_by_jump_step.size() - 1; i >= 0; i--)
-    {
-        if (i + index_mapping_by_jump_step[i] >= position)
-            index_mapping_by_jump_step[i] += length;
-        else
-            break;
-    }
-    
     // return insertion-size
     return length;
 }
@@ -1954,7 +2016,7 @@ int AliSimulator::handleInsertion(int &sequence_length, vector<int> &index_mappi
 /**
     handle deletion events
 */
-int AliSimulator::handleDeletion(int sequence_length, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method)
+int AliSimulator::handleDeletion(int sequence_length, IndelRope &indel_sequence, double &total_sub_rate, SIMULATION_METHOD simulation_method)
 {
     // Randomly generate the length (length_D) of sites (which will be deleted) from the indel-length distribution.
     int length = -1;
@@ -1976,30 +2038,19 @@ int AliSimulator::handleDeletion(int sequence_length, vector<short int> &indel_s
     if (upper_bound > 0)
         position = selectValidPositionForIndels(upper_bound, indel_sequence);
     
-    // Replace up to length_D sites by gaps from the sequence starting at the selected location
+    // Replace up to length_D sites by gaps from the sequence starting at the selected location, skipping sites that have already been deleted
     int real_deleted_length = 0;
     double sub_rate_change = 0;
-    for (int i = 0; i < length && (position + i) < indel_sequence.size(); i++)
+    for (int site = indel_sequence.getSite(position); site >= 0 && real_deleted_length < length; site = indel_sequence.getNextSite(site))
     {
-        // if the current site is not a gap (has not been deleted) -> replacing it by a gap
-        if (indel_sequence[position + i ] != STATE_UNKNOWN)
-        {
-            indel_sequence[position + i ] = STATE_UNKNOWN;
-            real_deleted_length++;
-        }
-        // otherwise, ignore the current site, moving forward to find a valid site (not a gap)
-        else
-        {
-            i--;
-            position++;
-        }
+        if (indel_sequence.isGap(site))
+            continue;
         
-        // if RATE_MATRIX approach is used -> update sub_rate_by_site
+        // if RATE_MATRIX approach is used -> update sub_rate_change
         if (simulation_method == RATE_MATRIX)
-        {
-            sub_rate_change -= sub_rate_by_site[position + i];
-            sub_rate_by_site[position + i] = 0;
-        }
+            sub_rate_change -= indel_sequence.getRate(site);
+        indel_sequence.setSite(site, STATE_UNKNOWN, 0);
+        real_deleted_length++;
     }
     
     // if RATE_MATRIX approach is used -> update total_sub_rate
@@ -2013,14 +2064,17 @@ int AliSimulator::handleDeletion(int sequence_length, vector<short int> &indel_s
 /**
     handle substitution events
 */
-void AliSimulator::handleSubs(int sequence_length, double &total_sub_rate, vector<double> &sub_rate_by_site, vector<short int> &indel_sequence, int num_mixture_models)
+void AliSimulator::handleSubs(double &total_sub_rate, IndelRope &indel_sequence, int num_mixture_models)
 {
-    // select a position where the substitution event occurs
-    discrete_distribution<> random_discrete_dis(sub_rate_by_site.begin(), sub_rate_by_site.end());
-    int pos = random_discrete_dis(params->generator);
+    // select a site where the substitution event occurs, with probability proportional to its substitution rate
+    double random_num = generate_canonical<double, numeric_limits<double>::digits>(params->generator);
+    int site = indel_sequence.selectSiteByRate(random_num*indel_sequence.getTotalRate());
+    if (site < 0)
+        return;
+    int pos = indel_sequence.getSource(site);
     
     // extract the current state
-    short int current_state = indel_sequence[pos];
+    short int current_state = indel_sequence.getState(site);
     
     // estimate the new state
     int mixture_index = 0;
@@ -2034,22 +2088,22 @@ void AliSimulator::handleSubs(int sequence_length, double &total_sub_rate, vecto
     }
     
     int starting_index = mixture_index*max_num_states*max_num_states + max_num_states*current_state;
-    indel_sequence[pos] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(Jmatrix, starting_index, max_num_states, max_num_states/2);
+    short int new_state = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(Jmatrix, starting_index, max_num_states, max_num_states/2);
     
     // update total_sub_rate
     double current_site_rate = site_specific_rates.size() == 0 ? 1 : site_specific_rates[pos];
-    double sub_rate_change = current_site_rate*(sub_rates[mixture_index*max_num_states + indel_sequence[pos]] - sub_rates[mixture_index*max_num_states + current_state]);
+    double sub_rate_change = current_site_rate*(sub_rates[mixture_index*max_num_states + new_state] - sub_rates[mixture_index*max_num_states + current_state]);
     total_sub_rate += sub_rate_change;
     
-    // update sub_rate_by_site
-    sub_rate_by_site[pos] += sub_rate_change;
+    // update the state and the substitution rate of the site
+    indel_sequence.setSite(site, new_state, indel_sequence.getRate(site) + sub_rate_change);
 }
 
 /**
 *  randomly select a valid position (not a deleted-site) for insertion/deletion event
 *
 */
-int AliSimulator::selectValidPositionForIndels(int upper_bound, vector<short int> sequence)
+int AliSimulator::selectValidPositionForIndels(int upper_bound, IndelRope &sequence)
 {
     int position = -1;
     for (int i = 0; i < upper_bound; i++)
@@ -2057,11 +2111,11 @@ int AliSimulator::selectValidPositionForIndels(int upper_bound, vector<short int
         position = random_int(upper_bound);
         
         // a valid position must not be a deleted site
-        if (position == sequence.size() || sequence[position] != STATE_UNKNOWN)
+        if (position == sequence.size() || !sequence.isGap(sequence.getSite(position)))
             break;
     }
     // validate the position
-    if (position < sequence.size() && sequence[position] == STATE_UNKNOWN)
+    if (position < sequence.size() && sequence.isGap(sequence.getSite(position)))
         outError("Sorry! Could not select a valid position (not a deleted-site) for insertion/deletion events. You may specify a too high deletion rate, thus almost all sites were deleted. Please try again a a smaller deletion ratio!");
     return position;
 }
@@ -2069,7 +2123,7 @@ int AliSimulator::selectValidPositionForIndels(int upper_bound, vector<short int
 /**
     merge the simulated sequence with indel_sequence
 */
-void AliSimulator::mergeIndelSequence(Node* node, vector<short int> indel_sequence, vector<int> index_mapping_by_jump_step)
+void AliSimulator::mergeIndelSequence(Node* node, vector<short int> &indel_sequence, vector<int> &index_mapping_by_jump_step)
 {
     // mapping state from the current sequence into indel_sequence
     for (int i = 0; i < index_mapping_by_jump_step.size() - 1; i++)
@@ -2079,11 +2133,9 @@ void AliSimulator::mergeIndelSequence(Node* node, vector<short int> indel_sequen
             indel_sequence[i+index_mapping_by_jump_step[i]] = node->sequence[i+index_mapping_by_jump_step[i]];
     }
     
-    // release the memory for the current sequence
-    vector<short int>().swap(node->sequence);
-    
-    // update the new sequence
-    node->sequence = indel_sequence;
+    // update the new sequence and release the memory for the current sequence
+    node->sequence.swap(indel_sequence);
+    vector<short int>().swap(indel_sequence);
 }
 
 /**
@@ -23,6 +23,7 @@
 #include "main/phylotesting.h"
 #include <random>
 #include "utils/gzstream.h"
+#include "indelrope.h"
 #ifdef _OPENMP
     #include <omp.h>
 #endif
@@ -215,17 +216,17 @@ protected:
     /**
         handle substitution events
     */
-    void handleSubs(int sequence_length, double &total_sub_rate, vector<double> &sub_rate_by_site, vector<short int> &indel_sequence, int num_mixture_models);
+    void handleSubs(double &total_sub_rate, IndelRope &indel_sequence, int num_mixture_models);
     
     /**
         handle insertion events, return the insertion-size
     */
-    int handleInsertion(int &sequence_length, vector<int> &index_mapping_by_jump_step, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method);
+    int handleInsertion(int &sequence_length, IndelRope &indel_sequence, double &total_sub_rate, SIMULATION_METHOD simulation_method);
     
     /**
         handle deletion events, return the deletion-size
     */
-    int handleDeletion(int sequence_length, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method);
+    int handleDeletion(int sequence_length, IndelRope &indel_sequence, double &total_sub_rate, SIMULATION_METHOD simulation_method);
     
     /**
         extract array of substitution rates and Jmatrix
@@ -235,30 +236,44 @@ protected:
     /**
         initialize variables for Rate_matrix approach: total_sub_rate, accumulated_rates, num_gaps
     */
-    virtual void initVariables4RateMatrix(double &total_sub_rate, int &num_gaps, vector<double> &sub_rate_by_site, vector<short int> sequence);
+    virtual void initVariables4RateMatrix(double &total_sub_rate, int &num_gaps, vector<double> &sub_rate_by_site, vector<short int> &sequence);
     
     /**
-    *  insert a new sequence into the current sequence
+    *  insert a new sequence into the current sequence.
+    *  Site-specific information of the new sites is appended to the site-specific vectors, at the source indices
+    *  of the new sites, and reordered by reorderSiteSpecificInfo() at the end of the branch
     *
     */
-    virtual void insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence);
+    virtual void insertNewSequenceForInsertionEvent(IndelRope &indel_sequence, int position, vector<short int> &new_sequence);
     
     /**
-    *  insert gaps into other nodes when processing Insertion Events
+        reorder the site-specific information according to the source indices of the sites after insertion events
+    */
+    void reorderSiteSpecificInfo(vector<int> &sources);
+    
+    /**
+    *  insert gaps into the sequence of a node for the sites which were inserted in other lineages
+    *  after the sequence had been simulated
+    *
+    */
+    void insertGapsForInsertionEvents(Node *node);
+    
+    /**
+    *  insert gaps into the sequences of all nodes of a subtree for the sites inserted in other lineages
     *
     */
-    void insertGapsForInsertionEvents(vector<int> index_mapping_by_jump_step, int stopping_node_id, Node *node, Node *dad, bool &stop_inserting_gaps);
+    void insertGapsForInsertionEvents(Node *node, Node *dad);
     
     /**
     *  randomly select a valid position (not a deleted-site) for insertion/deletion event
     *
     */
-    int selectValidPositionForIndels(int upper_bound, vector<short int> sequence);
+    int selectValidPositionForIndels(int upper_bound, IndelRope &sequence);
     
     /**
         merge the simulated sequence with indel_sequence
     */
-    virtual void mergeIndelSequence(Node* node, vector<short int> indel_sequence, vector<int> index_mapping_by_jump_step);
+    virtual void mergeIndelSequence(Node* node, vector<short int> &indel_sequence, vector<int> &index_mapping_by_jump_step);
     
     /**
         generate indel-size from its distribution
@@ -331,6 +346,13 @@ public:
     DoubleVector pattern_rates;
     IntVector site_to_patternID;
     
+    /**
+        for each site of the current alignment, the number of sites the alignment had when the site was inserted
+        (or its original position), such that sequences simulated before insertion events in other lineages can be
+        padded with gaps in one pass. Empty if no insertion has occurred yet
+    */
+    IntVector site_insertion_order;
+    
     /**
         constructor
     */
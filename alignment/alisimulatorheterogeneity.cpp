@@ -599,7 +599,7 @@ void AliSimulatorHeterogeneity::initVariables(int sequence_length, bool regenera
 *  insert a new sequence into the current sequence
 *
 */
-void AliSimulatorHeterogeneity::insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence)
+void AliSimulatorHeterogeneity::insertNewSequenceForInsertionEvent(IndelRope &indel_sequence, int position, vector<short int> &new_sequence)
 {
     // init new_site_to_patternID
     IntVector new_site_to_patternID;
@@ -615,27 +615,27 @@ void AliSimulatorHeterogeneity::insertNewSequenceForInsertionEvent(vector<short
             new_site_to_patternID[i] = site_to_patternID[site_id];
         }
         
-        // insert new_site_to_patternID into site_to_patternID
-        site_to_patternID.insert(site_to_patternID.begin()+position, new_site_to_patternID.begin(), new_site_to_patternID.end());
+        // append new_site_to_patternID to site_to_patternID (at the source indices of the new sites)
+        site_to_patternID.insert(site_to_patternID.end(), new_site_to_patternID.begin(), new_site_to_patternID.end());
     }
     
     // initialize new_site_specific_model_index
     vector<short int> new_site_specific_model_index;
     intializeSiteSpecificModelIndex(new_sequence.size(), new_site_specific_model_index, new_site_to_patternID);
     
-    // insert new_site_specific_model_index into site_specific_model_index
-    site_specific_model_index.insert(site_specific_model_index.begin()+position, new_site_specific_model_index.begin(), new_site_specific_model_index.end());
+    // append new_site_specific_model_index to site_specific_model_index
+    site_specific_model_index.insert(site_specific_model_index.end(), new_site_specific_model_index.begin(), new_site_specific_model_index.end());
     
     // initialize new_site_specific_rates, and new_site_specific_rate_index for new sequence
     vector<double> new_site_specific_rates;
     vector<short int> new_site_specific_rate_index;
     getSiteSpecificRates(new_site_specific_rate_index, new_site_specific_rates, new_site_specific_model_index, new_sequence.size(), new_site_to_patternID);
     
-    // insert new_site_specific_rates into site_specific_rates
-    site_specific_rates.insert(site_specific_rates.begin()+position, new_site_specific_rates.begin(), new_site_specific_rates.end());
+    // append new_site_specific_rates to site_specific_rates
+    site_specific_rates.insert(site_specific_rates.end(), new_site_specific_rates.begin(), new_site_specific_rates.end());
     
-    // insert new_site_specific_rate_index into site_specific_rate_index
-    site_specific_rate_index.insert(site_specific_rate_index.begin()+position, new_site_specific_rate_index.begin(), new_site_specific_rate_index.end());
+    // append new_site_specific_rate_index to site_specific_rate_index
+    site_specific_rate_index.insert(site_specific_rate_index.end(), new_site_specific_rate_index.begin(), new_site_specific_rate_index.end());
     
     // regenerate new_sequence if mixture model is used
     if (tree->getModel()->isMixture())
@@ -655,7 +655,7 @@ void AliSimulatorHeterogeneity::insertNewSequenceForInsertionEvent(vector<short
 /**
     initialize variables for Rate_matrix approach: total_sub_rate, accumulated_rates, num_gaps
 */
-void AliSimulatorHeterogeneity::initVariables4RateMatrix(double &total_sub_rate, int &num_gaps, vector<double> &sub_rate_by_site, vector<short int> sequence)
+void AliSimulatorHeterogeneity::initVariables4RateMatrix(double &total_sub_rate, int &num_gaps, vector<double> &sub_rate_by_site, vector<short int> &sequence)
 {
     // initialize variables
     int sequence_length = sequence.size();
@@ -84,14 +84,14 @@ void AliSimulatorInvar::initSiteSpecificRates(vector<double> &site_specific_rate
 *  insert a new sequence into the current sequence
 *
 */
-void AliSimulatorInvar::insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence)
+void AliSimulatorInvar::insertNewSequenceForInsertionEvent(IndelRope &indel_sequence, int position, vector<short int> &new_sequence)
 {
     // initialize new_site_specific_rates for new sequence
     vector<double> new_site_specific_rates;
     initSiteSpecificRates(new_site_specific_rates, new_sequence.size());
     
-    // insert new_site_specific_rates into site_specific_rates
-    site_specific_rates.insert(site_specific_rates.begin()+position, new_site_specific_rates.begin(), new_site_specific_rates.end());
+    // append new_site_specific_rates to site_specific_rates (at the source indices of the new sites)
+    site_specific_rates.insert(site_specific_rates.end(), new_site_specific_rates.begin(), new_site_specific_rates.end());
     
     // insert new_sequence into the current sequence
     AliSimulator::insertNewSequenceForInsertionEvent(indel_sequence, position, new_sequence);
@@ -0,0 +1,229 @@
+//
+//  indelrope.cpp
+//  iqtree
+//
+
+#include "indelrope.h"
+
+IndelRope::IndelRope() : root(-1), gap_state(0), random_state(0x9E3779B97F4A7C15ULL) {
+}
+
+uint32_t IndelRope::nextPriority() {
+    // xorshift64*
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (uint32_t)((random_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+void IndelRope::build(const vector<short int> &sequence, const vector<double> *rates, short int gap_state) {
+    this->gap_state = gap_state;
+    int length = sequence.size();
+    items.resize(length);
+    for (int i = 0; i < length; i++) {
+        Item &item = items[i];
+        item.state = sequence[i];
+        item.rate = rates ? (*rates)[i] : 0.0;
+        item.source = i;
+    }
+    root = buildTreap(0, length);
+}
+
+int IndelRope::buildTreap(int first, int last) {
+    // Cartesian tree of the priorities, using the right spine as a stack
+    vector<int> spine;
+    for (int i = first; i < last; i++) {
+        Item &item = items[i];
+        item.priority = nextPriority();
+        item.left = item.right = item.parent = -1;
+        int last_popped = -1;
+        while (!spine.empty() && items[spine.back()].priority < item.priority) {
+            last_popped = spine.back();
+            spine.pop_back();
+        }
+        if (last_popped >= 0) {
+            item.left = last_popped;
+            items[last_popped].parent = i;
+        }
+        if (!spine.empty()) {
+            items[spine.back()].right = i;
+            item.parent = spine.back();
+        }
+        spine.push_back(i);
+    }
+    if (spine.empty())
+        return -1;
+
+    // compute the aggregates bottom-up
+    int top = spine[0];
+    vector<int> stack, order;
+    stack.push_back(top);
+    while (!stack.empty()) {
+        int node = stack.back();
+        stack.pop_back();
+        order.push_back(node);
+        if (items[node].left >= 0) stack.push_back(items[node].left);
+        if (items[node].right >= 0) stack.push_back(items[node].right);
+    }
+    for (int i = order.size()-1; i >= 0; i--)
+        pull(order[i]);
+    return top;
+}
+
+void IndelRope::pull(int item) {
+    Item &it = items[item];
+    it.size = 1;
+    it.rate_sum = it.rate;
+    if (it.left >= 0) {
+        it.size += items[it.left].size;
+        it.rate_sum += items[it.left].rate_sum;
+    }
+    if (it.right >= 0) {
+        it.size += items[it.right].size;
+        it.rate_sum += items[it.right].rate_sum;
+    }
+}
+
+int IndelRope::getSite(int position) {
+    int node = root;
+    while (node >= 0) {
+        int left_size = items[node].left >= 0 ? items[items[node].left].size : 0;
+        if (position < left_size)
+            node = items[node].left;
+        else if (position == left_size)
+            return node;
+        else {
+            position -= left_size + 1;
+            node = items[node].right;
+        }
+    }
+    return -1;
+}
+
+int IndelRope::getNextSite(int site) {
+    if (items[site].right >= 0) {
+        site = items[site].right;
+        while (items[site].left >= 0)
+            site = items[site].left;
+        return site;
+    }
+    while (items[site].parent >= 0 && items[items[site].parent].right == site)
+        site = items[site].parent;
+    return items[site].parent;
+}
+
+int IndelRope::selectSiteByRate(double value) {
+    int node = root;
+    // fall back to the last site with a positive rate in case of rounding errors
+    int candidate = -1;
+    while (node >= 0) {
+        Item &it = items[node];
+        if (it.left >= 0) {
+            double left_sum = items[it.left].rate_sum;
+            if (value < left_sum) {
+                node = it.left;
+                continue;
+            }
+            value -= left_sum;
+        }
+        if (it.rate > 0.0) {
+            if (value < it.rate)
+                return node;
+            candidate = node;
+        }
+        value -= it.rate;
+        node = it.right;
+    }
+    return candidate;
+}
+
+void IndelRope::setSite(int site, short int state, double rate) {
+    items[site].state = state;
+    items[site].rate = rate;
+    for (int node = site; node >= 0; node = items[node].parent)
+        pull(node);
+}
+
+void IndelRope::split(int node, int count, int &left, int &right) {
+    if (node < 0) {
+        left = right = -1;
+        return;
+    }
+    Item &it = items[node];
+    int left_size = it.left >= 0 ? items[it.left].size : 0;
+    if (count <= left_size) {
+        int sub_left, sub_right;
+        split(it.left, count, sub_left, sub_right);
+        items[node].left = sub_right;
+        if (sub_right >= 0) items[sub_right].parent = node;
+        if (sub_left >= 0) items[sub_left].parent = -1;
+        items[node].parent = -1;
+        pull(node);
+        left = sub_left;
+        right = node;
+    } else {
+        int sub_left, sub_right;
+        split(it.right, count - left_size - 1, sub_left, sub_right);
+        items[node].right = sub_left;
+        if (sub_left >= 0) items[sub_left].parent = node;
+        if (sub_right >= 0) items[sub_right].parent = -1;
+        items[node].parent = -1;
+        pull(node);
+        left = node;
+        right = sub_right;
+    }
+}
+
+int IndelRope::merge(int left, int right) {
+    if (left < 0) return right;
+    if (right < 0) return left;
+    if (items[left].priority > items[right].priority) {
+        int child = merge(items[left].right, right);
+        items[left].right = child;
+        items[child].parent = left;
+        pull(left);
+        return left;
+    } else {
+        int child = merge(left, items[right].left);
+        items[right].left = child;
+        items[child].parent = right;
+        pull(right);
+        return right;
+    }
+}
+
+void IndelRope::insert(int position, const vector<short int> &states) {
+    int first = items.size();
+    items.resize(first + states.size());
+    for (int i = 0; i < states.size(); i++) {
+        Item &item = items[first+i];
+        item.state = states[i];
+        item.rate = 0.0;
+        item.source = first+i;
+    }
+    int new_sites = buildTreap(first, items.size());
+    int left, right;
+    split(root, position, left, right);
+    root = merge(merge(left, new_sites), right);
+    items[root].parent = -1;
+}
+
+void IndelRope::exportSequence(vector<short int> &sequence, vector<int> &sources) {
+    sequence.resize(size());
+    sources.resize(size());
+    // in-order traversal
+    vector<int> stack;
+    int node = root, pos = 0;
+    while (node >= 0 || !stack.empty()) {
+        while (node >= 0) {
+            stack.push_back(node);
+            node = items[node].left;
+        }
+        node = stack.back();
+        stack.pop_back();
+        sequence[pos] = items[node].state;
+        sources[pos] = items[node].source;
+        pos++;
+        node = items[node].right;
+    }
+}
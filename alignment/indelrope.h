@@ -0,0 +1,123 @@
+//
+//  indelrope.h
+//  iqtree
+//
+//  Sequence of sites under indel events for AliSim, stored as an implicit treap
+//  such that insertions, deletions and rate-weighted site selection take
+//  logarithmic time in the sequence length.
+//
+
+#ifndef indelrope_h
+#define indelrope_h
+
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+/**
+    a sequence of sites, each with a state, a substitution rate and a source index.
+    Sites are addressed by their position in the sequence or by a handle, which stays
+    valid while sites are inserted. The source index tells where the site comes from:
+    the position in the initial sequence, or numSources() at the time it was inserted.
+*/
+class IndelRope {
+public:
+
+    IndelRope();
+
+    /**
+        initialize the rope
+        @param sequence initial states
+        @param rates substitution rates of the sites, or NULL if not needed
+        @param gap_state state of deleted sites
+    */
+    void build(const vector<short int> &sequence, const vector<double> *rates, short int gap_state);
+
+    /** @return TRUE if the rope has not been built */
+    bool empty() { return items.empty(); }
+
+    /** @return number of sites including deleted ones */
+    int size() { return root < 0 ? 0 : items[root].size; }
+
+    /** @return number of sources (initial and inserted sites) */
+    int numSources() { return items.size(); }
+
+    /** @return sum of the rates of all sites */
+    double getTotalRate() { return root < 0 ? 0.0 : items[root].rate_sum; }
+
+    /** @return handle of the site at a position */
+    int getSite(int position);
+
+    /** @return handle of the next site, -1 at the end of the sequence */
+    int getNextSite(int site);
+
+    /**
+        select a site with probability proportional to its rate
+        @param value a number in [0, getTotalRate())
+        @return handle of the site, -1 if all rates are zero
+    */
+    int selectSiteByRate(double value);
+
+    short int getState(int site) { return items[site].state; }
+
+    double getRate(int site) { return items[site].rate; }
+
+    int getSource(int site) { return items[site].source; }
+
+    bool isGap(int site) { return items[site].state == gap_state; }
+
+    /** change the state and the rate of a site */
+    void setSite(int site, short int state, double rate);
+
+    /**
+        insert new sites with zero rates before a position
+        @param position the position, size() to append
+        @param states states of the new sites
+    */
+    void insert(int position, const vector<short int> &states);
+
+    /**
+        export the sequence
+        @param[out] sequence states in sequence order
+        @param[out] sources source indices in sequence order
+    */
+    void exportSequence(vector<short int> &sequence, vector<int> &sources);
+
+private:
+
+    struct Item {
+        int left, right, parent;
+        uint32_t priority;
+        int size;
+        double rate_sum;
+        double rate;
+        int source;
+        short int state;
+    };
+
+    vector<Item> items;
+
+    int root;
+
+    short int gap_state;
+
+    /** state of the generator of heap priorities, independent of the simulation RNG */
+    uint64_t random_state;
+
+    uint32_t nextPriority();
+
+    /** build a treap of consecutive items [first, last) in linear time, return its root */
+    int buildTreap(int first, int last);
+
+    /** recompute size and rate_sum of an item from its children */
+    void pull(int item);
+
+    /** split the treap into the first 'count' sites and the rest */
+    void split(int node, int count, int &left, int &right);
+
+    /** concatenate two treaps */
+    int merge(int left, int right);
+};
+
+#endif /* indelrope_h */
@@ -1621,6 +1621,7 @@ double SuperAlignment::computeMissingData() {
 Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
 	string union_taxa;
 	int nsites = 0, nstates = 0;
+    size_t npatterns = 0;
     set<int>::iterator it;
 	SeqType sub_type = SEQ_UNKNOWN;
 	for (it = ids.begin(); it != ids.end(); it++) {
@@ -1637,6 +1638,7 @@ Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
         Pattern taxa_pat = getPattern(id);
         taxa_set.insert(taxa_set.begin(), taxa_pat.begin(), taxa_pat.end());
 		nsites += partitions[id]->getNSite();
+        npatterns += partitions[id]->getNPattern();
 		if (it == ids.begin()) union_taxa = taxa_set; else {
 			for (int j = 0; j < union_taxa.length(); j++)
 				if (taxa_set[j] == 1) union_taxa[j] = 1;
@@ -1653,6 +1655,11 @@ Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
 	aln->site_pattern.resize(nsites, -1);
     aln->clear();
     aln->pattern_index.clear();
+    // avoid re-hashing the patterns while the merged pattern table grows
+    aln->reserve(npatterns);
+#ifdef USE_HASH_MAP
+    aln->pattern_index.rehash(npatterns);
+#endif
     aln->STATE_UNKNOWN = partitions[*ids.begin()]->STATE_UNKNOWN;
     aln->genetic_code = partitions[*ids.begin()]->genetic_code;
     if (aln->seq_type == SEQ_CODON) {
@@ -1680,7 +1687,26 @@ Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
             pattern_to_sites[pid].push_back(sid+site);
         }
 
+        // if the partition has all taxa in the same order, its patterns (incl. the constant-site
+        // information) can be taken as they are
+        bool same_taxa = true;
+        int num_taxa = 0;
+        for (int seq = 0; seq < union_taxa.size() && same_taxa; seq++)
+            if (union_taxa[seq] == 1)
+                same_taxa = (taxa_index[seq][id] == num_taxa++);
+        same_taxa = same_taxa && (num_taxa == subaln->getNSeq());
+
         for (Alignment::iterator it = partitions[id]->begin(); it != partitions[id]->end(); it++) {
+            int first_site = pattern_to_sites[it - partitions[id]->begin()][0];
+            if (same_taxa) {
+                Pattern pat = *it;
+                bool gaps_only;
+                aln->addPatternLazy(pat, first_site, (*it).frequency, gaps_only);
+                int ptnindex = aln->site_pattern[first_site];
+                for (auto sid : pattern_to_sites[it - partitions[id]->begin()])
+                    aln->site_pattern[sid] = ptnindex;
+                continue;
+            }
     		Pattern pat;
     		//int part_seq = 0;
     		for (int seq = 0; seq < union_taxa.size(); seq++)
@@ -1695,9 +1721,9 @@ Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
     				pat.push_back(ch);
     			}
     		//ASSERT(part_seq == partitions[id]->getNSeq());
-    		aln->addPattern(pat, pattern_to_sites[it - partitions[id]->begin()][0], (*it).frequency);
+    		aln->addPattern(pat, first_site, (*it).frequency);
     		// IMPORTANT BUG FIX FOLLOW
-    		int ptnindex = aln->pattern_index[pat];
+    		int ptnindex = aln->site_pattern[first_site];
 
             // 2021-04-14: build original site to patterns index
             ASSERT((*it).frequency == pattern_to_sites[it - partitions[id]->begin()].size());
@@ -6,6 +6,7 @@
  */
 
 #include "alisim.h"
+#include "utils/asyncstream.h"
 #include <chrono>
 using namespace std::chrono;
 
@@ -701,16 +702,14 @@ void writeSequencesToFile(string file_path, Alignment *aln, int sequence_length,
 {
     try {
             // init output_stream for Indels to output aln without gaps
-            ostream *out_indels = NULL;
+            AsyncOutputStream *out_indels = NULL;
             bool write_indels_output = false;
             if (alisimulator->params->alisim_insertion_ratio + alisimulator->params->alisim_deletion_ratio > 0
                 && !alisimulator->params->alisim_no_export_sequence_wo_gaps)
             {
                 write_indels_output = true;
-                if (alisimulator->params->do_compression)
-                    out_indels = new ogzstream((file_path+"_withoutgaps.fa").c_str());
-                else
-                    out_indels = new ofstream((file_path+"_withoutgaps.fa").c_str());
+                // compression (if any) is done by the background writer thread
+                out_indels = new AsyncOutputStream((file_path+"_withoutgaps.fa").c_str(), ios::out, alisimulator->params->do_compression);
             }
         
             // add ".phy" or ".fa" to the output_filepath
@@ -718,11 +717,7 @@ void writeSequencesToFile(string file_path, Alignment *aln, int sequence_length,
                 file_path = file_path + ".phy";
             else
                 file_path = file_path + ".fa";
-            ostream *out;
-            if (alisimulator->params->do_compression)
-                out = new ogzstream(file_path.c_str());
-            else
-                out = new ofstream(file_path.c_str());
+            AsyncOutputStream *out = new AsyncOutputStream(file_path.c_str(), ios::out, alisimulator->params->do_compression);
             out->exceptions(ios::failbit | ios::badbit);
 
             // write the first line <#taxa> <length_of_sequence> (for PHYLIP output format)
@@ -747,18 +742,12 @@ void writeSequencesToFile(string file_path, Alignment *aln, int sequence_length,
             if (write_indels_output)
             {
                 // close the file
-                if (alisimulator->params->do_compression)
-                    ((ogzstream*)out_indels)->close();
-                else
-                    ((ofstream*)out_indels)->close();
+                out_indels->close();
                 delete out_indels;
             }
             
             // close the file
-            if (alisimulator->params->do_compression)
-                ((ogzstream*)out)->close();
-            else
-                ((ofstream*)out)->close();
+            out->close();
             delete out;
         
             // show the output file name
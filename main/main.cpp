@@ -50,6 +50,7 @@
 #include "nclextra/msetsblock.h"
 #include "nclextra/myreader.h"
 #include "phyloanalysis.h"
+#include "treetesting.h"
 #include "alisim.h"
 #include "tree/matree.h"
 #include "obsolete/parsmultistate.h"
@@ -61,6 +62,7 @@
 #include "pda/ecopdmtreeset.h"
 #include "pda/gurobiwrapper.h"
 #include "utils/timeutil.h"
+#include "utils/asyncstream.h"
 #include "utils/operatingsystem.h" //for getOSName()
 #include <stdlib.h>
 #include "vectorclass/instrset.h"
@@ -2245,6 +2247,7 @@ int main(int argc, char *argv[]) {
     /*************************/
 
     parseArg(argc, argv, Params::getInstance());
+    setAsyncOutput(Params::getInstance().async_output);
 
     // 2015-12-05
     Checkpoint *checkpoint = new Checkpoint;
@@ -2517,6 +2520,8 @@ int main(int argc, char *argv[]) {
         runAliSim(Params::getInstance(), checkpoint);
     } else if (Params::getInstance().tree_gen != NONE && Params::getInstance().start_tree!=STT_RANDOM_TREE) {
         generateRandomTree(Params::getInstance());
+    } else if (Params::getInstance().ancestral_bin_file) {
+        convertAncestralStateBinary(Params::getInstance().ancestral_bin_file, Params::getInstance().out_prefix);
     } else if (Params::getInstance().do_pars_multistate) {
         doParsMultiState(Params::getInstance());
     } else if (Params::getInstance().rf_dist_mode != 0) {
@@ -1420,8 +1420,8 @@ void transferModelParameters(PhyloSuperTree *super_tree, ModelCheckpoint &model_
         make_tuple(VAL_SINGLE, ARIT_MEAN, (string)"RateGamma" + CKP_SEP + "gamma_shape"),
         make_tuple(VAL_SINGLE, ARIT_MEAN, (string)"RateGammaInvar" + CKP_SEP + "gamma_shape"),
         make_tuple(VAL_SINGLE, ARIT_MEAN, (string)"RateGammaInvar" + CKP_SEP + "p_invar"),
-        make_tuple(VAL_SINGLE, ARIT_MEAN, (string)"RateInvar" + CKP_SEP + "p_invar")
-        //make_tuple(VAL_VECTOR, GEOM_MEAN, (string)"ModelDNA" + CKP_SEP + "rates")
+        make_tuple(VAL_SINGLE, ARIT_MEAN, (string)"RateInvar" + CKP_SEP + "p_invar"),
+        make_tuple(VAL_VECTOR, GEOM_MEAN, (string)"ModelDNA" + CKP_SEP + "rates")
     };
     for (auto info : info_strings) {
         switch (std::get<0>(info)) {
@@ -1724,6 +1724,19 @@ struct ModelPair {
     string model_name;
 };
 
+/** hash function for a set of partition IDs */
+struct hashGeneSet {
+    size_t operator()(const set<int> &gene_set) const {
+        size_t sum = gene_set.size();
+        for (int id : gene_set)
+            sum ^= id + 0x9e3779b9 + (sum << 6) + (sum >> 2);
+        return sum;
+    }
+};
+
+/** results of merged partitions already evaluated, to avoid checkpoint lookups in later iterations */
+typedef unordered_map<set<int>, ModelPair, hashGeneSet> ModelPairCache;
+
 class ModelPairSet : public multimap<double, ModelPair> {
 
 public:
@@ -1903,6 +1916,50 @@ bool comparePartition(const pair<int,double> &a, const pair<int, double> &b) {
     return a.second > b.second;
 }
 
+/**
+ * schedule the model tests of all partitions. Partitions are sorted by decreasing cost,
+ * which is proportional to #sequences, #patterns and #states, and zero for partitions
+ * already done in the checkpoint. When testing in parallel over partitions with one
+ * thread each, a partition costing more than the average load per thread would keep
+ * running long after the others are done; such partitions are tested first, one after
+ * another with all threads.
+ * @param[out] partitionID partition IDs and costs, sorted by decreasing cost
+ * @param[out] parallel_over_partitions TRUE to test the remaining partitions in parallel
+ * @return number of partitions at the front of partitionID to be tested with all threads
+ */
+int schedulePartitionTests(Params &params, PhyloSuperTree *in_tree, ModelCheckpoint &model_info,
+    int num_threads, vector<pair<int,double> > &partitionID, bool &parallel_over_partitions)
+{
+    partitionID.clear();
+    double total_cost = 0.0;
+    for (int i = 0; i < in_tree->size(); i++) {
+        Alignment *this_aln = in_tree->at(i)->aln;
+        ModelCheckpoint part_model_info;
+        string best_model;
+        extractModelInfo(this_aln->name, model_info, part_model_info);
+        double cost = 0.0;
+        if (!part_model_info.getBestModel(best_model))
+            cost = ((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states;
+        partitionID.push_back({i, cost});
+        total_cost += cost;
+    }
+    parallel_over_partitions = false;
+    if (num_threads <= 1)
+        return 0;
+    std::sort(partitionID.begin(), partitionID.end(), comparePartition);
+#ifdef _OPENMP
+    parallel_over_partitions = !params.model_test_and_tree && (in_tree->size() >= num_threads);
+#endif
+    if (!parallel_over_partitions)
+        return 0;
+    int num_big = 0;
+    while (num_big < partitionID.size() && partitionID[num_big].second > total_cost / num_threads)
+        num_big++;
+    if (num_big > 0 && verbose_mode >= VB_MED)
+        cout << num_big << " large partitions are tested with " << num_threads << " threads each" << endl;
+    return num_big;
+}
+
 /**
  find k-closest partition pairs for rcluster algorithm
  */
@@ -2011,27 +2068,24 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
 
     // sort partition by computational cost for OpenMP effciency
     vector<pair<int,double> > partitionID;
-    
-	for (i = 0; i < in_tree->size(); i++) {
-        Alignment *this_aln = in_tree->at(i)->aln;
-        // computation cost is proportional to #sequences, #patterns, and #states
-        partitionID.push_back({i, ((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states});
-    }
-    if (num_threads > 1) {
-        std::sort(partitionID.begin(), partitionID.end(), comparePartition);
-    }
-    bool parallel_over_partitions = false;
+    bool parallel_over_partitions;
+    int num_big_partitions = schedulePartitionTests(params, in_tree, model_info, num_threads,
+        partitionID, parallel_over_partitions);
     int brlen_type = params.partition_type;
     if (brlen_type == TOPO_UNLINKED) {
         brlen_type = BRLEN_OPTIMIZE;
     }
     bool test_merge = (params.partition_merge != MERGE_NONE) && params.partition_type != TOPO_UNLINKED && (in_tree->size() > 1);
     
+    // large partitions with all threads first, then the rest in parallel
+    for (int phase = 0; phase < 2; phase++) {
+    bool parallel_phase = (phase == 1) && parallel_over_partitions;
+    int first = (phase == 0) ? 0 : num_big_partitions;
+    int last = (phase == 0) ? num_big_partitions : in_tree->size();
 #ifdef _OPENMP
-    parallel_over_partitions = !params.model_test_and_tree && (in_tree->size() >= num_threads);
-#pragma omp parallel for private(i) schedule(dynamic) reduction(+: lhsum, dfsum) if(parallel_over_partitions)
+#pragma omp parallel for private(i) schedule(dynamic) reduction(+: lhsum, dfsum) if(parallel_phase)
 #endif
-	for (int j = 0; j < in_tree->size(); j++) {
+	for (int j = first; j < last; j++) {
         i = partitionID[j].first;
         PhyloTree *this_tree = in_tree->at(i);
 		// scan through models for this partition, assuming the information occurs consecutively
@@ -2043,7 +2097,7 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
             part_model_name = this_tree->aln->model_name;
         CandidateModel best_model;
 		best_model = CandidateModelSet().test(params, this_tree, part_model_info, models_block,
-            (parallel_over_partitions ? 1 : num_threads), brlen_type, this_tree->aln->name, part_model_name, test_merge);
+            (parallel_phase ? 1 : num_threads), brlen_type, this_tree->aln->name, part_model_name, test_merge);
 
         bool check = (best_model.restoreCheckpoint(&part_model_info));
         ASSERT(check);
@@ -2078,6 +2132,7 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
             model_info.dump();
         }
     }
+    }
 
     // in case ModelOMatic change the alignment
     fixPartitions(in_tree);
@@ -2128,6 +2183,9 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
         cout << "Merging models to increase model fit (about " << total_num_model << " total partition schemes)..." << endl;
     }
 
+    // merged partitions evaluated so far
+    ModelPairCache pair_cache;
+
     /* following implements the greedy algorithm of Lanfear et al. (2012) */
 	while (params.partition_merge != MERGE_KMEANS && gene_sets.size() >= 2) {
 		// stepwise merging charsets
@@ -2147,18 +2205,38 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
             findClosestPairs(super_aln, lenvec, gene_sets, true, log_closest_pairs);
             mergePairs(closest_pairs, log_closest_pairs);
         }
-        // sort partition by computational cost for OpenMP effciency
-        for (i = 0; i < closest_pairs.size(); i++) {
-            // computation cost is proportional to #sequences, #patterns, and #states
-            Alignment *this_aln = in_tree->at(closest_pairs[i].first)->aln;
-            closest_pairs[i].distance = -((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states;
-            this_aln = in_tree->at(closest_pairs[i].second)->aln;
-            closest_pairs[i].distance -= ((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states;
+        // pairs evaluated in previous iterations are taken from the cache, only the score changes
+        vector<SubsetPair> new_pairs;
+        for (auto &closest_pair : closest_pairs) {
+            set<int> merged_set;
+            merged_set.insert(gene_sets[closest_pair.first].begin(), gene_sets[closest_pair.first].end());
+            merged_set.insert(gene_sets[closest_pair.second].begin(), gene_sets[closest_pair.second].end());
+            auto cached = pair_cache.find(merged_set);
+            if (cached == pair_cache.end()) {
+                // computation cost is proportional to #sequences, #patterns, and #states of the merged partitions
+                closest_pair.distance = 0.0;
+                for (auto id : merged_set) {
+                    Alignment *this_aln = in_tree->at(id)->aln;
+                    closest_pair.distance -= ((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states;
+                }
+                new_pairs.push_back(closest_pair);
+                continue;
+            }
+            ModelPair cur_pair = cached->second;
+            cur_pair.part1 = closest_pair.first;
+            cur_pair.part2 = closest_pair.second;
+            double lhnew = lhsum - lhvec[cur_pair.part1] - lhvec[cur_pair.part2] + cur_pair.logl;
+            int dfnew = dfsum - dfvec[cur_pair.part1] - dfvec[cur_pair.part2] + cur_pair.df;
+            cur_pair.score = computeInformationScore(lhnew, dfnew, ssize, params.model_test_criterion);
+            if (cur_pair.score < inf_score)
+                better_pairs.insertPair(cur_pair);
         }
+
+        // sort partition pairs by computational cost for OpenMP effciency
         if (num_threads > 1) {
-            std::sort(closest_pairs.begin(), closest_pairs.end(), comparePairs);
+            std::sort(new_pairs.begin(), new_pairs.end(), comparePairs);
         }
-        size_t num_pairs = closest_pairs.size();
+        size_t num_pairs = new_pairs.size();
         
 #ifdef _OPENMP
 #pragma omp parallel for private(i) schedule(dynamic) if(!params.model_test_and_tree)
@@ -2166,8 +2244,8 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
         for (size_t pair = 0; pair < num_pairs; pair++) {
             // information of current partitions pair
             ModelPair cur_pair;
-            cur_pair.part1 = closest_pairs[pair].first;
-            cur_pair.part2 = closest_pairs[pair].second;
+            cur_pair.part1 = new_pairs[pair].first;
+            cur_pair.part2 = new_pairs[pair].second;
             ASSERT(cur_pair.part1 < cur_pair.part2);
             cur_pair.merged_set.insert(gene_sets[cur_pair.part1].begin(), gene_sets[cur_pair.part1].end());
             cur_pair.merged_set.insert(gene_sets[cur_pair.part2].begin(), gene_sets[cur_pair.part2].end());
@@ -2251,6 +2329,7 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
 				}
                 if (cur_pair.score < inf_score)
                     better_pairs.insertPair(cur_pair);
+                pair_cache[cur_pair.merged_set] = cur_pair;
 			}
 
         }
@@ -2332,22 +2411,17 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
         }
 
         // sort partition by computational cost for OpenMP effciency
-        partitionID.clear();
-        for (i = 0; i < in_tree->size(); i++) {
-            Alignment *this_aln = in_tree->at(i)->aln;
-            // computation cost is proportional to #sequences, #patterns, and #states
-            partitionID.push_back({i, ((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states});
-        }
-        
-        if (num_threads > 1) {
-            std::sort(partitionID.begin(), partitionID.end(), comparePartition);
-        }
+        num_big_partitions = schedulePartitionTests(params, in_tree, model_info, num_threads,
+            partitionID, parallel_over_partitions);
 
+        for (int phase = 0; phase < 2; phase++) {
+        bool parallel_phase = (phase == 1) && parallel_over_partitions;
+        int first = (phase == 0) ? 0 : num_big_partitions;
+        int last = (phase == 0) ? num_big_partitions : in_tree->size();
     #ifdef _OPENMP
-        parallel_over_partitions = !params.model_test_and_tree && (in_tree->size() >= num_threads);
-        #pragma omp parallel for private(i) schedule(dynamic) reduction(+: lhsum, dfsum) if(parallel_over_partitions)
+        #pragma omp parallel for private(i) schedule(dynamic) reduction(+: lhsum, dfsum) if(parallel_phase)
     #endif
-        for (int j = 0; j < in_tree->size(); j++) {
+        for (int j = first; j < last; j++) {
             i = partitionID[j].first;
             PhyloTree *this_tree = in_tree->at(i);
             // scan through models for this partition, assuming the information occurs consecutively
@@ -2359,7 +2433,7 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
                 part_model_name = this_tree->aln->model_name;
             CandidateModel best_model;
             best_model = CandidateModelSet().test(params, this_tree, part_model_info, models_block,
-                (parallel_over_partitions ? 1 : num_threads), brlen_type,
+                (parallel_phase ? 1 : num_threads), brlen_type,
                 this_tree->aln->name, part_model_name, false);
             
             bool check = (best_model.restoreCheckpoint(&part_model_info));
@@ -2392,6 +2466,7 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
             model_info.dump();
             }
         }
+        }
     }
 
     inf_score = computeInformationScore(lhsum, dfsum, ssize, params.model_test_criterion);
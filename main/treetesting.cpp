@@ -17,6 +17,8 @@
 #include "tree/phylosupertree.h"
 #include "gsl/mygsl.h"
 #include "utils/timeutil.h"
+#include "utils/gzstream.h"
+#include "utils/asyncstream.h"
 
 
 void printSiteLh(const char*filename, PhyloTree *tree, double *ptn_lh,
@@ -29,7 +31,7 @@ void printSiteLh(const char*filename, PhyloTree *tree, double *ptn_lh,
         pattern_lh = ptn_lh;
     
     try {
-        ofstream out;
+        AsyncOutputStream out;
         out.exceptions(ios::failbit | ios::badbit);
         if (append) {
             out.open(filename, ios::out | ios::app);
@@ -82,7 +84,7 @@ void printPartitionLh(const char*filename, PhyloTree *tree, double *ptn_lh,
     }
     
     try {
-        ofstream out;
+        AsyncOutputStream out;
         out.exceptions(ios::failbit | ios::badbit);
         if (append) {
             out.open(filename, ios::out | ios::app);
@@ -126,7 +128,7 @@ void printSiteLhCategory(const char*filename, PhyloTree *tree, SiteLoglType wsl)
     
     
     try {
-        ofstream out;
+        AsyncOutputStream out;
         out.exceptions(ios::failbit | ios::badbit);
         out.open(filename);
         out << "# Site likelihood per rate/mixture category" << endl
@@ -179,8 +181,174 @@ void printSiteLhCategory(const char*filename, PhyloTree *tree, SiteLoglType wsl)
     
 }
 
+/**
+    print the comment lines and the column header of the tab-separated .state file
+    @param out output stream
+    @param out_prefix output prefix of the analysis
+    @param first_part_name name of the first partition, NULL for unpartitioned analysis
+    @param state_names names of the states shown in the column header
+*/
+static void printAncestralStateHeader(ostream &out, const char *out_prefix, const char *first_part_name, StrVector &state_names) {
+    out << "# Ancestral state reconstruction for all nodes in " << out_prefix << ".treefile" << endl
+    << "# This file can be read in MS Excel or in R with command:" << endl
+    << "#   tab=read.table('" <<  out_prefix << ".state',header=TRUE)" << endl
+    << "# Columns are tab-separated with following meaning:" << endl
+    << "#   Node:  Node name in the tree" << endl;
+    if (first_part_name) {
+        out << "#   Part:  Partition ID (1=" << first_part_name << ", etc)" << endl
+        << "#   Site:  Site ID within partition (starting from 1 for each partition)" << endl;
+    } else
+        out << "#   Site:  Alignment site ID" << endl;
+
+    out << "#   State: Most likely state assignment" << endl
+    << "#   p_X:   Posterior probability for state X (empirical Bayesian method)" << endl;
+
+    if (first_part_name)
+        out << "Node\tPart\tSite\tState";
+    else
+        out << "Node\tSite\tState";
+    for (auto name : state_names)
+        out << "\tp_" << name;
+    out << endl;
+}
+
+/** magic string at the start of a binary ancestral state file */
+static const char ANCESTRAL_BIN_MAGIC[8] = {'I', 'Q', 'A', 'S', 'R', 'B', '1', 0};
+
+template <class T>
+static inline void writeBinary(ostream &out, const T &value) {
+    out.write((const char*)&value, sizeof(T));
+}
+
+template <class T>
+static inline void readBinary(istream &in, T &value) {
+    in.read((char*)&value, sizeof(T));
+}
+
+static void writeBinaryString(ostream &out, const string &str) {
+    uint32_t len = str.length();
+    writeBinary(out, len);
+    out.write(str.c_str(), len);
+}
+
+static void readBinaryString(istream &in, string &str) {
+    uint32_t len;
+    readBinary(in, len);
+    str.resize(len);
+    if (len > 0)
+        in.read(&str[0], len);
+}
+
+/**
+    print marginal ancestral states per pattern into a compressed binary file.
+    Layout: magic, out_prefix, partitioned flag, #partitions, #nodes, then per partition its name, #sites, #patterns,
+    #states, state names (the last one for the unknown state) and the site-to-pattern index;
+    then per node its name followed by, for each partition, the int32 state column
+    and the float32 probability matrix (#patterns x #states)
+    @param out_prefix output prefix
+    @param tree phylogenetic tree
+*/
+static void printAncestralSequencesBinary(const char *out_prefix, PhyloTree *tree) {
+    string filename = (string)out_prefix + ".statebin";
+
+    vector<PhyloTree*> part_trees;
+    if (tree->isSuperTree()) {
+        PhyloSuperTree *stree = (PhyloSuperTree*)tree;
+        part_trees.insert(part_trees.end(), stree->begin(), stree->end());
+    } else
+        part_trees.push_back(tree);
+
+    try {
+        ogzstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(filename.c_str());
+
+        NodeVector nodes;
+        tree->getInternalNodes(nodes);
+
+        out.write(ANCESTRAL_BIN_MAGIC, sizeof(ANCESTRAL_BIN_MAGIC));
+        writeBinaryString(out, out_prefix);
+        writeBinary(out, (int32_t)tree->isSuperTree());
+        writeBinary(out, (int32_t)part_trees.size());
+        writeBinary(out, (int32_t)nodes.size());
+
+        size_t total_size = 0, total_ptn = 0;
+        for (auto part_tree : part_trees) {
+            Alignment *aln = part_tree->aln;
+            int nstates = part_tree->getModel()->num_states;
+            writeBinaryString(out, aln->name);
+            writeBinary(out, (uint64_t)aln->getNSite());
+            writeBinary(out, (uint64_t)aln->getNPattern());
+            writeBinary(out, (int32_t)nstates);
+            for (int i = 0; i < nstates; i++)
+                writeBinaryString(out, aln->convertStateBackStr(i));
+            writeBinaryString(out, aln->convertStateBackStr(aln->STATE_UNKNOWN));
+            IntVector pattern_index;
+            aln->getSitePatternIndex(pattern_index);
+            out.write((const char*)pattern_index.data(), sizeof(int)*pattern_index.size());
+            total_size += aln->getNPattern()*nstates;
+            total_ptn += aln->getNPattern();
+        }
+
+        double *marginal_ancestral_prob;
+        int *marginal_ancestral_seq;
+        float *prob_buffer = aligned_alloc<float>(total_size);
+
+        bool orig_kernel_nonrev;
+        tree->initMarginalAncestralState(out, orig_kernel_nonrev, marginal_ancestral_prob, marginal_ancestral_seq);
+
+        for (NodeVector::iterator it = nodes.begin(); it != nodes.end(); it++) {
+            PhyloNode *node = (PhyloNode*)(*it);
+            PhyloNode *dad = (PhyloNode*)node->neighbors[0]->node;
+
+            tree->computeMarginalAncestralState((PhyloNeighbor*)dad->findNeighbor(node), dad,
+                                                marginal_ancestral_prob, marginal_ancestral_seq);
+
+            // set node name if neccessary
+            if (node->name.empty() || !isalpha(node->name[0])) {
+                node->name = "Node" + convertIntToString(node->id-tree->leafNum+1);
+            }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(tree->num_threads)
+#endif
+            for (size_t i = 0; i < total_size; i++)
+                prob_buffer[i] = marginal_ancestral_prob[i];
+
+            // partitions are stored consecutively in both buffers
+            writeBinaryString(out, node->name);
+            double *ptn_prob = marginal_ancestral_prob;
+            int *ptn_seq = marginal_ancestral_seq;
+            float *out_prob = prob_buffer;
+            for (auto part_tree : part_trees) {
+                size_t nptn = part_tree->aln->getNPattern();
+                size_t size = nptn*part_tree->getModel()->num_states;
+                out.write((const char*)ptn_seq, sizeof(int)*nptn);
+                out.write((const char*)out_prob, sizeof(float)*size);
+                ptn_seq += nptn;
+                ptn_prob += size;
+                out_prob += size;
+            }
+        }
+
+        tree->endMarginalAncestralState(orig_kernel_nonrev, marginal_ancestral_prob, marginal_ancestral_seq);
+        aligned_free(prob_buffer);
+
+        out.close();
+        cout << "Ancestral state probabilities per pattern printed to " << filename << endl;
+        cout << "  (convert to .state format via: --asr-bin2txt " << filename << ")" << endl;
+    } catch (ios::failure) {
+        outError(ERR_WRITE_OUTPUT, filename);
+    }
+}
+
 void printAncestralSequences(const char *out_prefix, PhyloTree *tree, AncestralSeqType ast) {
-    
+
+    if (tree->params->print_ancestral_binary) {
+        printAncestralSequencesBinary(out_prefix, tree);
+        return;
+    }
+
     //    int *joint_ancestral = NULL;
     //
     //    if (tree->params->print_ancestral_sequence == AST_JOINT) {
@@ -188,11 +356,15 @@ void printAncestralSequences(const char *out_prefix, PhyloTree *tree, AncestralS
     //        tree->computeJointAncestralSequences(joint_ancestral);
     //    }
     
-    string filename = (string)out_prefix + ".state";
+    // the prefix defaults to the binary file itself, keep its log apart from the original run
+    string filename = out_prefix;
+    if (filename.length() > 9 && filename.substr(filename.length()-9) == ".statebin")
+        filename = filename.substr(0, filename.length()-9);
+    filename += ".state";
     //    string filenameseq = (string)out_prefix + ".stateseq";
     
     try {
-        ofstream out;
+        AsyncOutputStream out;
         out.exceptions(ios::failbit | ios::badbit);
         out.open(filename.c_str());
         out.setf(ios::fixed, ios::floatfield);
@@ -215,33 +387,17 @@ void printAncestralSequences(const char *out_prefix, PhyloTree *tree, AncestralS
         //
         //        int name_width = max(tree->aln->getMaxSeqNameLength(),6)+10;
         
-        out << "# Ancestral state reconstruction for all nodes in " << tree->params->out_prefix << ".treefile" << endl
-        << "# This file can be read in MS Excel or in R with command:" << endl
-        << "#   tab=read.table('" <<  tree->params->out_prefix << ".state',header=TRUE)" << endl
-        << "# Columns are tab-separated with following meaning:" << endl
-        << "#   Node:  Node name in the tree" << endl;
+        StrVector state_names;
         if (tree->isSuperTree()) {
             PhyloSuperTree *stree = (PhyloSuperTree*)tree;
-            out << "#   Part:  Partition ID (1=" << stree->at(0)->aln->name << ", etc)" << endl
-            << "#   Site:  Site ID within partition (starting from 1 for each partition)" << endl;
-        } else
-            out << "#   Site:  Alignment site ID" << endl;
-        
-        out << "#   State: Most likely state assignment" << endl
-        << "#   p_X:   Posterior probability for state X (empirical Bayesian method)" << endl;
-        
-        if (tree->isSuperTree()) {
-            PhyloSuperTree *stree = (PhyloSuperTree*)tree;
-            out << "Node\tPart\tSite\tState";
             for (size_t i = 0; i < stree->front()->aln->num_states; i++)
-                out << "\tp_" << stree->front()->aln->convertStateBackStr(i);
+                state_names.push_back(stree->front()->aln->convertStateBackStr(i));
+            printAncestralStateHeader(out, tree->params->out_prefix, stree->at(0)->aln->name.c_str(), state_names);
         } else {
-            out << "Node\tSite\tState";
             for (size_t i = 0; i < tree->aln->num_states; i++)
-                out << "\tp_" << tree->aln->convertStateBackStr(i);
+                state_names.push_back(tree->aln->convertStateBackStr(i));
+            printAncestralStateHeader(out, tree->params->out_prefix, NULL, state_names);
         }
-        out << endl;
-        
         
         bool orig_kernel_nonrev;
         tree->initMarginalAncestralState(out, orig_kernel_nonrev, marginal_ancestral_prob, marginal_ancestral_seq);
@@ -295,6 +451,101 @@ void printAncestralSequences(const char *out_prefix, PhyloTree *tree, AncestralS
     
 }
 
+void convertAncestralStateBinary(const char *bin_file, const char *out_prefix) {
+    // the prefix defaults to the binary file itself, keep its log apart from the original run
+    string filename = out_prefix;
+    if (filename.length() > 9 && filename.substr(filename.length()-9) == ".statebin")
+        filename = filename.substr(0, filename.length()-9);
+    filename += ".state";
+
+    /** per-partition metadata of the binary file */
+    struct AncestralBinPart {
+        string name;
+        uint64_t nsite, nptn;
+        int32_t nstates;
+        StrVector state_names;
+        IntVector pattern_index;
+    };
+
+    try {
+        igzstream in;
+        in.exceptions(ios::failbit | ios::badbit);
+        in.open(bin_file);
+
+        char magic[sizeof(ANCESTRAL_BIN_MAGIC)];
+        in.read(magic, sizeof(magic));
+        if (memcmp(magic, ANCESTRAL_BIN_MAGIC, sizeof(magic)) != 0)
+            outError(bin_file, " is not a binary ancestral state file");
+
+        string prefix;
+        int32_t partitioned, npart, nnodes;
+        readBinaryString(in, prefix);
+        readBinary(in, partitioned);
+        readBinary(in, npart);
+        readBinary(in, nnodes);
+        vector<AncestralBinPart> parts(npart);
+        for (auto &part : parts) {
+            readBinaryString(in, part.name);
+            readBinary(in, part.nsite);
+            readBinary(in, part.nptn);
+            readBinary(in, part.nstates);
+            part.state_names.resize(part.nstates+1);
+            for (auto &name : part.state_names)
+                readBinaryString(in, name);
+            part.pattern_index.resize(part.nsite);
+            in.read((char*)part.pattern_index.data(), sizeof(int)*part.nsite);
+        }
+
+        AsyncOutputStream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(filename.c_str());
+        out.setf(ios::fixed, ios::floatfield);
+        out.precision(5);
+
+        StrVector state_names(parts[0].state_names.begin(), parts[0].state_names.end()-1);
+        printAncestralStateHeader(out, prefix.c_str(), partitioned ? parts[0].name.c_str() : NULL, state_names);
+
+        IntVector ptn_seq;
+        vector<float> ptn_prob;
+        StrVector ptn_str;
+        for (int32_t node = 0; node < nnodes; node++) {
+            string node_name;
+            readBinaryString(in, node_name);
+            int part_id = 1;
+            for (auto &part : parts) {
+                ptn_seq.resize(part.nptn);
+                ptn_prob.resize(part.nptn*part.nstates);
+                in.read((char*)ptn_seq.data(), sizeof(int)*part.nptn);
+                in.read((char*)ptn_prob.data(), sizeof(float)*ptn_prob.size());
+                // format the columns once per pattern
+                ptn_str.resize(part.nptn);
+                for (size_t ptn = 0; ptn < part.nptn; ptn++) {
+                    ostringstream ss;
+                    ss.flags(out.flags());
+                    ss.precision(out.precision());
+                    int state = ptn_seq[ptn];
+                    ss << part.state_names[(state >= 0 && state < part.nstates) ? state : part.nstates];
+                    for (int32_t j = 0; j < part.nstates; j++)
+                        ss << "\t" << ptn_prob[ptn*part.nstates+j];
+                    ptn_str[ptn] = ss.str();
+                }
+                for (size_t site = 0; site < part.nsite; site++) {
+                    out << node_name << "\t";
+                    if (partitioned)
+                        out << part_id << "\t";
+                    out << site+1 << "\t" << ptn_str[part.pattern_index[site]] << "\n";
+                }
+                part_id++;
+            }
+        }
+        in.close();
+        out.close();
+        cout << "Ancestral state probabilities printed to " << filename << endl;
+    } catch (ios::failure) {
+        outError(ERR_READ_INPUT, bin_file);
+    }
+}
+
 void printSiteProbCategory(const char*filename, PhyloTree *tree, SiteLoglType wsl) {
     
     if (wsl == WSL_NONE || wsl == WSL_SITE)
@@ -317,7 +568,7 @@ void printSiteProbCategory(const char*filename, PhyloTree *tree, SiteLoglType ws
     tree->computePatternProbabilityCategory(ptn_prob_cat, wsl);
     
     try {
-        ofstream out;
+        AsyncOutputStream out;
         out.exceptions(ios::failbit | ios::badbit);
         out.open(filename);
         if (tree->isSuperTree())
@@ -376,7 +627,7 @@ void printSiteStateFreq(const char*filename, PhyloTree *tree, double *state_freq
     }
     
     try {
-        ofstream out;
+        AsyncOutputStream out;
         out.exceptions(ios::failbit | ios::badbit);
         out.open(filename);
         IntVector pattern_index;
@@ -406,7 +657,7 @@ void printSiteStateFreq(const char* filename, Alignment *aln) {
     size_t nsites  = aln->getNSite();
     int    nstates = aln->num_states;
     try {
-        ofstream out;
+        AsyncOutputStream out;
         out.exceptions(ios::failbit | ios::badbit);
         out.open(filename);
         IntVector pattern_index;
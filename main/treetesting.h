@@ -87,6 +87,13 @@ void printSiteStateFreq(const char* filename, Alignment *aln);
 */
 void printAncestralSequences(const char*filename, PhyloTree *tree, AncestralSeqType ast);
 
+/**
+    convert a binary ancestral state file written with --asr-bin into the tab-separated .state format
+    @param bin_file binary .statebin file
+    @param out_prefix output prefix (a trailing .statebin is stripped), <out_prefix>.state is written
+*/
+void convertAncestralStateBinary(const char *bin_file, const char *out_prefix);
+
 /**
  * Evaluate user-trees with possibility of tree topology tests
  * @param params program parameters
@@ -29,6 +29,9 @@ using namespace Eigen;
 
 #include <vectorclass/vectormath_exp.h>
 #include <vectorclass/vectorclass.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /** number of squaring for scaling-squaring technique */
 //const int TimeSquare = 10;
@@ -447,18 +450,37 @@ void ModelMarkov::computeTransMatrixNonrev(double time, double *trans_matrix, in
         ASSERT(maxcoeff < 1.001 && mincoeff > 0.999);
         trans_mat = mat;
     } else if (phylo_tree->params->matrix_exp_technique == MET_EIGEN3LIB_DECOMPOSITION) {
-        VectorXcd ceval_exp(num_states);
-        ArrayXcd eval = Map<ArrayXcd,Aligned>(ceval, num_states);
-        ceval_exp = (eval*time).exp().matrix();
-        Map<MatrixXcd,Aligned> cevectors(cevec, num_states, num_states);
-        Map<MatrixXcd,Aligned> cinv_evectors(cinv_evec, num_states, num_states);
-        MatrixXcd res = cevectors * ceval_exp.asDiagonal() * cinv_evectors;
-        Map<Matrix<double,Dynamic,Dynamic,RowMajor> >map_trans(trans_matrix,num_states,num_states);
-        map_trans = res.real();
+        // P(t) = real(V * exp(D*t) * V^-1), computed row by row without heap temporaries.
+        // cevec and cinv_evec are stored column-major
+        double exp_re[num_states], exp_im[num_states];
+        double row_re[num_states], row_im[num_states];
+        int i, j, k;
+        for (j = 0; j < num_states; j++) {
+            std::complex<double> val = std::exp(ceval[j]*time);
+            exp_re[j] = val.real();
+            exp_im[j] = val.imag();
+        }
+        double mincoeff = DBL_MAX, maxcoeff = -DBL_MAX;
+        for (i = 0; i < num_states; i++) {
+            for (j = 0; j < num_states; j++) {
+                std::complex<double> &v = cevec[i + j*num_states];
+                row_re[j] = v.real()*exp_re[j] - v.imag()*exp_im[j];
+                row_im[j] = v.real()*exp_im[j] + v.imag()*exp_re[j];
+            }
+            double row_sum = 0.0;
+            double *trans_row = trans_matrix + i*num_states;
+            for (k = 0; k < num_states; k++) {
+                std::complex<double> *inv_col = cinv_evec + k*num_states;
+                double val = 0.0;
+                for (j = 0; j < num_states; j++)
+                    val += row_re[j]*inv_col[j].real() - row_im[j]*inv_col[j].imag();
+                trans_row[k] = val;
+                row_sum += val;
+            }
+            mincoeff = min(mincoeff, row_sum);
+            maxcoeff = max(maxcoeff, row_sum);
+        }
         // sanity check rows sum to 1
-        VectorXd row_sum = map_trans.rowwise().sum();
-        double mincoeff = row_sum.minCoeff();
-        double maxcoeff = row_sum.maxCoeff();
         if (maxcoeff > 1.0001 || mincoeff < 0.9999) {
             if (verbose_mode >= VB_MED)
                 cout << "INFO: Switch to scaling-squaring due to unstable eigen-decomposition rowsum: "
@@ -698,41 +720,29 @@ void ModelMarkov::aTimesDiagonalBTimesTransposeOfC(const double* matrixA, const
     }
 }
 
+void ModelMarkov::multiplyRateMatrix(double *mat, double *res) {
+    for (int i = 0; i < num_states; i++) {
+        double *res_row = res + i*num_states;
+        double *rate_row = rate_matrix + i*num_states;
+        memset(res_row, 0, sizeof(double)*num_states);
+        for (int k = 0; k < num_states; k++) {
+            double rate = rate_row[k];
+            double *mat_row = mat + k*num_states;
+            for (int j = 0; j < num_states; j++)
+                res_row[j] += rate * mat_row[j];
+        }
+    }
+}
+
 void ModelMarkov::computeTransDerv(double time, double *trans_matrix, 
 	double *trans_derv1, double *trans_derv2, int mixture)
 {
     if (!is_reversible) {
         computeTransMatrix(time, trans_matrix);
         // First derivative = Q * e^(Qt)
-        Map<Matrix<double, Dynamic, Dynamic, RowMajor> > trans_mat(trans_matrix, num_states, num_states);
-        Map<Matrix<double, Dynamic, Dynamic, RowMajor> > rate_mat(rate_matrix, num_states, num_states);
-        MatrixXd prod = rate_mat * trans_mat;
-        Map<Matrix<double, Dynamic, Dynamic, RowMajor> > derv1_mat(trans_derv1, num_states, num_states);
-        derv1_mat = prod;
-
-        // Second derivative = Q * Q * e^(Qt)
-        prod = rate_mat * prod;
-        Map<Matrix<double, Dynamic, Dynamic, RowMajor> > derv2_mat(trans_derv2, num_states, num_states);
-        derv2_mat = prod;
-
-        /*
-        for (int i = 0; i < num_states; i++)
-            for (int j = 0; j < num_states; j++) {
-                double val = 0.0;
-                for (int k = 0; k < num_states; k++)
-                    val += rate_matrix[i*num_states+k] * trans_matrix[k*num_states+j];
-                trans_derv1[i*num_states+j] = val;
-            }
-            
         // Second derivative = Q * Q * e^(Qt)
-        for (int i = 0; i < num_states; i++)
-            for (int j = 0; j < num_states; j++) {
-                double val = 0.0;
-                for (int k = 0; k < num_states; k++)
-                    val += rate_matrix[i*num_states+k] * trans_derv1[k*num_states+j];
-                trans_derv2[i*num_states+j] = val;
-            }
-         */
+        multiplyRateMatrix(trans_matrix, trans_derv1);
+        multiplyRateMatrix(trans_derv1, trans_derv2);
         return;
     }
 
@@ -1086,6 +1096,344 @@ double ModelMarkov::targetFunk(double x[]) {
 
 }
 
+bool ModelMarkov::isTransMatrixGradientSupported() {
+    if (!is_reversible || num_params == -1 || isMixture() || isSiteSpecificModel() || isPolymorphismAware())
+        return false;
+    if (!phylo_tree || phylo_tree->getModel() != this || phylo_tree->isSuperTree() ||
+        phylo_tree->isMixlen() || phylo_tree->rooted || !phylo_tree->root)
+        return false;
+    if (phylo_tree->getModelFactory() && !phylo_tree->getModelFactory()->unobserved_ptns.empty())
+        return false;
+    RateHeterogeneity *site_rate = phylo_tree->getRate();
+    if (!site_rate || site_rate->isSiteSpecificRate() || site_rate->isHeterotachy())
+        return false;
+    // ptn_invar depends on state_freq, which is not covered by the derivatives
+    if (site_rate->getPInvar() > 0.0 && freq_type == FREQ_ESTIMATE)
+        return false;
+    for (int i = 0; i < num_states; i++)
+        if (state_freq[i] <= ZERO_FREQ)
+            return false;
+    return true;
+}
+
+/** maximal number of patterns processed together in ModelMarkov::computeTransMatrixDerv */
+const int TRANS_DERV_BLOCK = 32;
+
+typedef Map<Matrix<double, Dynamic, Dynamic, RowMajor> > MatrixMap;
+
+/**
+    rescale partial likelihoods of a block of patterns, stored as [state][ptn] rows of length nptn,
+    by 2^SCALING_THRESHOLD_EXP while all entries of a pattern are too small
+*/
+static void rescaleTransDervBlock(double *vec, int nrows, int nptn, int *scale) {
+    double max_val[TRANS_DERV_BLOCK];
+    int p, i;
+    for (p = 0; p < nptn; p++)
+        max_val[p] = 0.0;
+    for (i = 0; i < nrows; i++) {
+        double *row = vec + i*nptn;
+        for (p = 0; p < nptn; p++)
+            max_val[p] = max(max_val[p], row[p]);
+    }
+    for (p = 0; p < nptn; p++)
+        while (max_val[p] > 0.0 && max_val[p] < SCALING_THRESHOLD) {
+            for (i = 0; i < nrows; i++)
+                vec[i*nptn+p] = ldexp(vec[i*nptn+p], SCALING_THRESHOLD_EXP);
+            max_val[p] = ldexp(max_val[p], SCALING_THRESHOLD_EXP);
+            scale[p]++;
+        }
+}
+
+void ModelMarkov::computeTransMatrixDerv(DoubleVector &lengths, DoubleVector &trans_derv, double *freq_derv) {
+    PhyloTree *tree = phylo_tree;
+    RateHeterogeneity *site_rate = tree->getRate();
+    int ncat = site_rate->getNDiscreteRate();
+    size_t nptn = tree->aln->getNPattern();
+    int nstates = num_states;
+    int nstates_sqr = nstates*nstates;
+    int nrows = ncat*nstates;
+    int nnodes = tree->nodeNum;
+    int c, x;
+
+    // nodes in pre-order from the root, with their dads and the branch index to their dads
+    vector<PhyloNode*> nodes, node_dad(nnodes, NULL);
+    vector<int> branch_id(nnodes, -1);
+    nodes.push_back((PhyloNode*)tree->root);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        FOR_NEIGHBOR_IT(nodes[i], node_dad[nodes[i]->id], it) {
+            PhyloNode *child = (PhyloNode*)(*it)->node;
+            node_dad[child->id] = nodes[i];
+            branch_id[child->id] = nodes.size()-1;
+            nodes.push_back(child);
+        }
+    }
+    size_t nbranches = nodes.size()-1;
+
+    // transition matrices for all pairs of branch and category
+    lengths.resize(nbranches*ncat);
+    trans_derv.assign(nbranches*ncat*nstates_sqr, 0.0);
+    DoubleVector trans_mat(nbranches*ncat*nstates_sqr);
+    for (size_t i = 1; i < nodes.size(); i++) {
+        int b = branch_id[nodes[i]->id];
+        double len = nodes[i]->findNeighbor(node_dad[nodes[i]->id])->length;
+        for (c = 0; c < ncat; c++) {
+            lengths[b*ncat+c] = len * site_rate->getRate(c);
+            computeTransMatrix(lengths[b*ncat+c], &trans_mat[(b*ncat+c)*nstates_sqr]);
+        }
+    }
+
+    DoubleVector tip_lh((tree->aln->STATE_UNKNOWN+1)*nstates);
+    for (int state = 0; state <= tree->aln->STATE_UNKNOWN; state++)
+        computeTipLikelihood(state, &tip_lh[state*nstates]);
+
+    double sum_freq = 0.0;
+    for (x = 0; x < nstates; x++)
+        sum_freq += state_freq[x];
+    DoubleVector root_freq(nstates);
+    for (x = 0; x < nstates; x++)
+        root_freq[x] = state_freq[x] / sum_freq;
+
+    DoubleVector prop(ncat);
+    for (c = 0; c < ncat; c++)
+        prop[c] = site_rate->getProp(c);
+
+    // patterns are processed in blocks, limited to about 8 MB of partial likelihoods per thread
+    int block = TRANS_DERV_BLOCK;
+    while (block > 1 && (size_t)nnodes*nrows*block*3 > (1 << 20))
+        block /= 2;
+    int block_size = nrows*block;
+    size_t nblocks = (nptn + block - 1) / block;
+
+    int num_threads = max(tree->num_threads, 1);
+    vector<DoubleVector> thread_trans_derv(num_threads);
+    vector<DoubleVector> thread_freq_derv(num_threads);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads)
+#endif
+    {
+#ifdef _OPENMP
+        int thread_id = omp_get_thread_num();
+#else
+        int thread_id = 0;
+#endif
+        DoubleVector &my_trans_derv = thread_trans_derv[thread_id];
+        DoubleVector &my_freq_derv = thread_freq_derv[thread_id];
+        my_trans_derv.resize(trans_derv.size(), 0.0);
+        my_freq_derv.resize(nstates, 0.0);
+        // partial likelihoods below a node, at the dad end of its branch, and outside its subtree,
+        // each stored as rows [category*nstates+state] of the patterns in the block
+        DoubleVector lh_below(nnodes*block_size), lh_branch(nnodes*block_size), lh_outside(nnodes*block_size);
+        DoubleVector lh_dad(block_size);
+        vector<int> scale_below(nnodes*block), scale_outside(nnodes*block);
+        double lh[TRANS_DERV_BLOCK], ptn_weight[TRANS_DERV_BLOCK];
+        VectorXd norm(block);
+        int scale_dad[TRANS_DERV_BLOCK];
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,1)
+#endif
+        for (size_t blk = 0; blk < nblocks; blk++) {
+            size_t ptn_start = blk*block;
+            int nblock_ptn = min((size_t)block, nptn - ptn_start);
+            int p, y;
+
+            // post-order traversal
+            for (size_t i = nodes.size(); i-- > 0; ) {
+                PhyloNode *node = nodes[i];
+                double *below = &lh_below[node->id*block_size];
+                int *scale = &scale_below[node->id*block];
+                for (p = 0; p < block; p++)
+                    scale[p] = 0;
+                if (node->isLeaf()) {
+                    for (p = 0; p < block; p++) {
+                        int state = (p < nblock_ptn) ? tree->aln->at(ptn_start+p)[node->id] : tree->aln->STATE_UNKNOWN;
+                        double *tip = &tip_lh[state*nstates];
+                        for (c = 0; c < ncat; c++)
+                            for (x = 0; x < nstates; x++)
+                                below[(c*nstates+x)*block+p] = tip[x];
+                    }
+                } else {
+                    for (x = 0; x < block_size; x++)
+                        below[x] = 1.0;
+                }
+                FOR_NEIGHBOR_IT(node, node_dad[node->id], it) {
+                    int child = (*it)->node->id;
+                    double *child_branch = &lh_branch[child*block_size];
+                    for (x = 0; x < block_size; x++)
+                        below[x] *= child_branch[x];
+                    for (p = 0; p < block; p++)
+                        scale[p] += scale_below[child*block+p];
+                    rescaleTransDervBlock(below, nrows, block, scale);
+                }
+                if (i == 0)
+                    break;
+                int b = branch_id[node->id];
+                double *branch = &lh_branch[node->id*block_size];
+                for (c = 0; c < ncat; c++) {
+                    MatrixMap mat(&trans_mat[(b*ncat+c)*nstates_sqr], nstates, nstates);
+                    MatrixMap in(below + c*nstates*block, nstates, block);
+                    MatrixMap out(branch + c*nstates*block, nstates, block);
+                    out.noalias() = mat * in;
+                }
+            }
+
+            // likelihood at the root
+            PhyloNode *root = nodes[0];
+            double *root_below = &lh_below[root->id*block_size];
+            int *root_scale = &scale_below[root->id*block];
+            for (p = 0; p < block; p++)
+                lh[p] = 0.0;
+            for (c = 0; c < ncat; c++)
+                for (x = 0; x < nstates; x++) {
+                    double coeff = prop[c] * root_freq[x];
+                    double *in = root_below + (c*nstates+x)*block;
+                    for (p = 0; p < block; p++)
+                        lh[p] += coeff * in[p];
+                }
+            for (p = 0; p < block; p++) {
+                if (p >= nblock_ptn) {
+                    ptn_weight[p] = 0.0;
+                    continue;
+                }
+                if (tree->ptn_invar[ptn_start+p] > 0.0)
+                    lh[p] += ldexp(tree->ptn_invar[ptn_start+p], SCALING_THRESHOLD_EXP*root_scale[p]);
+                ptn_weight[p] = tree->ptn_freq[ptn_start+p] / lh[p];
+            }
+            for (c = 0; c < ncat; c++)
+                for (x = 0; x < nstates; x++) {
+                    double *in = root_below + (c*nstates+x)*block;
+                    double sum = 0.0;
+                    for (p = 0; p < block; p++)
+                        sum += ptn_weight[p] * in[p];
+                    my_freq_derv[x] += prop[c] * sum;
+                }
+
+            // pre-order traversal, the outside of the root is the state frequency
+            double *root_outside = &lh_outside[root->id*block_size];
+            for (c = 0; c < ncat; c++)
+                for (x = 0; x < nstates; x++)
+                    for (p = 0; p < block; p++)
+                        root_outside[(c*nstates+x)*block+p] = root_freq[x];
+            for (p = 0; p < block; p++)
+                scale_outside[root->id*block+p] = 0;
+            for (size_t i = 1; i < nodes.size(); i++) {
+                PhyloNode *node = nodes[i];
+                PhyloNode *dad = node_dad[node->id];
+                int b = branch_id[node->id];
+                // partial likelihood at the dad end of the branch, excluding the subtree of node
+                memcpy(&lh_dad[0], &lh_outside[dad->id*block_size], block_size*sizeof(double));
+                memcpy(scale_dad, &scale_outside[dad->id*block], block*sizeof(int));
+                if (dad->isLeaf()) {
+                    for (p = 0; p < block; p++) {
+                        int state = (p < nblock_ptn) ? tree->aln->at(ptn_start+p)[dad->id] : tree->aln->STATE_UNKNOWN;
+                        double *tip = &tip_lh[state*nstates];
+                        for (c = 0; c < ncat; c++)
+                            for (x = 0; x < nstates; x++)
+                                lh_dad[(c*nstates+x)*block+p] *= tip[x];
+                    }
+                }
+                FOR_NEIGHBOR_IT(dad, node_dad[dad->id], it) {
+                    int sibling = (*it)->node->id;
+                    if (sibling == node->id)
+                        continue;
+                    double *sibling_branch = &lh_branch[sibling*block_size];
+                    for (x = 0; x < block_size; x++)
+                        lh_dad[x] *= sibling_branch[x];
+                    for (p = 0; p < block; p++)
+                        scale_dad[p] += scale_below[sibling*block+p];
+                    rescaleTransDervBlock(&lh_dad[0], nrows, block, scale_dad);
+                }
+
+                // accumulate derivatives w.r.t. the transition matrices of this branch
+                double *below = &lh_below[node->id*block_size];
+                double *outside = &lh_outside[node->id*block_size];
+                for (p = 0; p < block; p++) {
+                    int scale_diff = scale_dad[p] + scale_below[node->id*block+p] - root_scale[p];
+                    norm(p) = (scale_diff == 0) ? ptn_weight[p] : ptn_weight[p] * ldexp(1.0, -SCALING_THRESHOLD_EXP*scale_diff);
+                }
+                for (c = 0; c < ncat; c++) {
+                    MatrixMap mat(&trans_mat[(b*ncat+c)*nstates_sqr], nstates, nstates);
+                    MatrixMap derv(&my_trans_derv[(b*ncat+c)*nstates_sqr], nstates, nstates);
+                    MatrixMap dad_lh(&lh_dad[c*nstates*block], nstates, block);
+                    MatrixMap node_lh(below + c*nstates*block, nstates, block);
+                    MatrixMap out(outside + c*nstates*block, nstates, block);
+                    derv.noalias() += prop[c] * (dad_lh * norm.asDiagonal()) * node_lh.transpose();
+                    out.noalias() = mat.transpose() * dad_lh;
+                }
+                memcpy(&scale_outside[node->id*block], scale_dad, block*sizeof(int));
+                rescaleTransDervBlock(outside, nrows, block, &scale_outside[node->id*block]);
+            }
+        }
+    }
+
+    memset(freq_derv, 0, nstates*sizeof(double));
+    for (int t = 0; t < num_threads; t++) {
+        if (thread_trans_derv[t].empty())
+            continue;
+        for (size_t i = 0; i < trans_derv.size(); i++)
+            trans_derv[i] += thread_trans_derv[t][i];
+        for (x = 0; x < nstates; x++)
+            freq_derv[x] += thread_freq_derv[t][x];
+    }
+}
+
+double ModelMarkov::computeTransMatrixDervTerm(DoubleVector &lengths, DoubleVector &trans_derv, double *freq_derv) {
+    int nstates_sqr = num_states*num_states;
+    double *trans_mat = new double[nstates_sqr];
+    double term = 0.0;
+    int i;
+    for (size_t pair = 0; pair < lengths.size(); pair++) {
+        computeTransMatrix(lengths[pair], trans_mat);
+        double *derv = &trans_derv[pair*nstates_sqr];
+        for (i = 0; i < nstates_sqr; i++)
+            term += derv[i] * trans_mat[i];
+    }
+    delete [] trans_mat;
+    double sum_freq = 0.0;
+    for (i = 0; i < num_states; i++)
+        sum_freq += state_freq[i];
+    for (i = 0; i < num_states; i++)
+        term += freq_derv[i] * state_freq[i] / sum_freq;
+    return term;
+}
+
+double ModelMarkov::derivativeFunk(double x[], double dfx[]) {
+    // one call of computeTransMatrixDerv costs about 2+48/num_states likelihood evaluations,
+    // thus finite differences remain cheaper for models with few parameters
+    if (getNDim() <= 2 + 48/num_states || !isTransMatrixGradientSupported())
+        return Optimization::derivativeFunk(x, dfx);
+    double fx = targetFunk(x);
+    if (fx >= 1.0e+30 || !isTransMatrixGradientSupported())
+        return Optimization::derivativeFunk(x, dfx);
+
+    // the log-likelihood is linear in each transition matrix and in the root frequencies,
+    // thus its gradient equals the gradient of this first-order term
+    DoubleVector lengths, trans_derv;
+    double *freq_derv = new double[num_states];
+    computeTransMatrixDerv(lengths, trans_derv, freq_derv);
+    double term = computeTransMatrixDervTerm(lengths, trans_derv, freq_derv);
+
+    int ndim = getNDim();
+    for (int dim = 1; dim <= ndim; dim++) {
+        double temp = x[dim];
+        double h = 1.0e-4 * fabs(temp);
+        if (h == 0.0) h = 1.0e-4;
+        x[dim] = temp + h;
+        h = x[dim] - temp;
+        getVariables(x);
+        decomposeRateMatrix();
+        dfx[dim] = -(computeTransMatrixDervTerm(lengths, trans_derv, freq_derv) - term) / h;
+        x[dim] = temp;
+    }
+    delete [] freq_derv;
+
+    // restore the model, the partial likelihoods at x are still valid
+    getVariables(x);
+    decomposeRateMatrix();
+    return fx;
+}
+
 bool ModelMarkov::isUnstableParameters() {
 	int nrates = getNumRateEntries();
 	int i;
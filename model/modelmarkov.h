@@ -197,6 +197,13 @@ public:
      */
     virtual void computeTransMatrixNonrev(double time, double *trans_matrix, int mixture = 0);
 
+    /**
+     left-multiply a matrix by the rate matrix
+     @param mat a num_states * num_states matrix
+     @param res (OUT) rate_matrix * mat, must not overlap mat
+     */
+    void multiplyRateMatrix(double *mat, double *res);
+
 	/**
 		compute the transition probability between two states
 		@param time time between two events
@@ -303,6 +310,18 @@ public:
 	*/
 	virtual double targetFunk(double x[]);
 
+	/**
+		the approximated derivative function. For a reversible model of a single tree,
+		the derivatives of the log-likelihood with respect to the transition matrices are
+		computed exactly in one post-order and one pre-order traversal, and only the mapping
+		from parameters to transition matrices is differentiated numerically. This avoids
+		one likelihood evaluation per dimension. Otherwise finite differences are used.
+		@param x the input vector x
+		@param dfx the derivative at x
+		@return the function value at x
+	*/
+	virtual double derivativeFunk(double x[], double dfx[]);
+
 	/**
 	 * setup the bounds for joint optimization with BFGS
 	 */
@@ -446,6 +465,27 @@ public:
     
 protected:
 
+	/**
+		@return TRUE if derivativeFunk can use the derivatives with respect to transition matrices
+	*/
+	bool isTransMatrixGradientSupported();
+
+	/**
+		compute the derivatives of the log-likelihood with respect to the transition matrices
+		of all pairs of branch and rate category, and with respect to the root state frequencies
+		@param[out] lengths branch length times category rate, one per pair
+		@param[out] trans_derv derivatives w.r.t. transition matrix, num_states*num_states per pair
+		@param[out] freq_derv derivatives w.r.t. state frequencies (num_states entries)
+	*/
+	void computeTransMatrixDerv(DoubleVector &lengths, DoubleVector &trans_derv, double *freq_derv);
+
+	/**
+		@return the first-order term sum(trans_derv*P(lengths)) + sum(freq_derv*state_freq)
+		for the current model parameters
+	*/
+	double computeTransMatrixDervTerm(DoubleVector &lengths, DoubleVector &trans_derv, double *freq_derv);
+
+
 	/**
 		this function is served for the multi-dimension optimization. It should pack the model parameters 
 		into a vector that is index from 1 (NOTE: not from 0)
@@ -1608,76 +1608,99 @@ double ModelMixture::targetFunk(double x[]) {
 	return -phylo_tree->computeLikelihood();
 }
 
+double ModelMixture::updateWeightsEM(double *base_prop, double *cur_prop, double *new_prop) {
+    size_t c, nmix = getNMixtures();
+    double *ratio_prop = aligned_alloc<double>(nmix);
+    for (c = 0; c < nmix; c++)
+        ratio_prop[c] = cur_prop[c] / base_prop[c];
+    double logl = phylo_tree->computePatternPosteriorCat(nmix, ratio_prop, new_prop, false);
+    for (c = 0; c < nmix; c++) {
+        new_prop[c] /= phylo_tree->getAlnNSite();
+        // Make sure that probabilities do not get zero
+        if (new_prop[c] < 1e-10) new_prop[c] = 1e-10;
+    }
+    aligned_free(ratio_prop);
+    return logl;
+}
+
 double ModelMixture::optimizeWeights() {
     // first compute _pattern_lh_cat
     phylo_tree->computePatternLhCat(WSL_MIXTURE);
-    size_t ptn, c;
-    size_t nptn = phylo_tree->aln->getNPattern();
+    size_t c;
     size_t nmix = getNMixtures();
 
-    double *new_prop = aligned_alloc<double>(nmix);
-    double *ratio_prop = aligned_alloc<double>(nmix);
-
-    // EM algorithm loop described in Wang, Li, Susko, and Roger (2008)
-
-    for (int step = 0; step < optimize_steps; step++) {
-        // E-step
-
-        if (step > 0) {
-            // convert _pattern_lh_cat taking into account new weights
-            for (ptn = 0; ptn < nptn; ptn++) {
-                double *this_lk_cat = phylo_tree->_pattern_lh_cat + ptn*nmix;
-                for (c = 0; c < nmix; c++) {
-                    this_lk_cat[c] *= ratio_prop[c];
-                }
-            }
+    double *base_prop = aligned_alloc<double>(nmix);
+    double *prop1 = aligned_alloc<double>(nmix);
+    double *prop2 = aligned_alloc<double>(nmix);
+    double *prop3 = aligned_alloc<double>(nmix);
+    memcpy(base_prop, prop, nmix*sizeof(double));
+
+    // EM algorithm loop described in Wang, Li, Susko, and Roger (2008),
+    // accelerated by squared extrapolation (SQUAREM, Varadhan and Roland 2008)
+    int step, num_passes = 0;
+    for (step = 0; step < optimize_steps; step += 2) {
+        // two plain EM steps
+        double logl = updateWeightsEM(base_prop, prop, prop1);
+        num_passes++;
+        bool converged = true;
+        for (c = 0; c < nmix; c++)
+            converged = converged && (fabs(prop[c]-prop1[c]) < 1e-4);
+        if (converged || step+1 >= optimize_steps) {
+            memcpy(prop, prop1, nmix*sizeof(double));
+            break;
         }
-        memset(new_prop, 0, nmix*sizeof(double));
-        for (ptn = 0; ptn < nptn; ptn++) {
-            double *this_lk_cat = phylo_tree->_pattern_lh_cat + ptn*nmix;
-            double lk_ptn = phylo_tree->ptn_invar[ptn];
-//            double lk_ptn = 0.0;
-            for (c = 0; c < nmix; c++) {
-                lk_ptn += this_lk_cat[c];
-            }
-            ASSERT(lk_ptn != 0.0);
-            lk_ptn = phylo_tree->ptn_freq[ptn] / lk_ptn;
-            for (c = 0; c < nmix; c++) {
-                new_prop[c] += this_lk_cat[c] * lk_ptn;
-            }
+        updateWeightsEM(base_prop, prop1, prop2);
+        num_passes++;
+        converged = true;
+        for (c = 0; c < nmix; c++)
+            converged = converged && (fabs(prop1[c]-prop2[c]) < 1e-4);
+        if (converged) {
+            memcpy(prop, prop2, nmix*sizeof(double));
+            break;
         }
-        bool converged = true;
-//        double new_pinvar = 0.0;
+
+        // extrapolate along the EM path: prop - 2*alpha*r + alpha^2*v
+        double r_norm = 0.0, v_norm = 0.0, sum2 = 0.0, sum3 = 0.0;
         for (c = 0; c < nmix; c++) {
-            new_prop[c] /= phylo_tree->getAlnNSite();
-            // Make sure that probabilities do not get zero
-            if (new_prop[c] < 1e-10) new_prop[c] = 1e-10;
-            // check for convergence
-            converged = converged && (fabs(prop[c]-new_prop[c]) < 1e-4);
-            ratio_prop[c] = new_prop[c] / prop[c];
-            if (std::isnan(ratio_prop[c])) {
-                cerr << "BUG: " << new_prop[c] << " " << prop[c] << " " << ratio_prop[c] << endl;
-            }
-            prop[c] = new_prop[c];
-//            new_pinvar += prop[c];
+            double r = prop1[c] - prop[c];
+            double v = prop2[c] - 2.0*prop1[c] + prop[c];
+            r_norm += r*r;
+            v_norm += v*v;
+            sum2 += prop2[c];
         }
-        /*
-        new_pinvar = 1.0 - new_pinvar;
-        if (new_pinvar != 0.0) {
-            converged = converged && (fabs(phylo_tree->getRate()->getPInvar()-new_pinvar) < 1e-4);
-            phylo_tree->getRate()->setPInvar(new_pinvar);
-            phylo_tree->getRate()->setOptimizePInvar(false);
-            phylo_tree->computePtnInvar();
-
+        double alpha = (v_norm > 0.0) ? -sqrt(r_norm/v_norm) : -1.0;
+        if (alpha > -1.0)
+            alpha = -1.0;
+        for (c = 0; c < nmix; c++) {
+            double r = prop1[c] - prop[c];
+            double v = prop2[c] - 2.0*prop1[c] + prop[c];
+            prop3[c] = max(prop[c] - 2.0*alpha*r + alpha*alpha*v, 1e-10);
+            sum3 += prop3[c];
         }
-        */
-        if (converged) break;
-
+        for (c = 0; c < nmix; c++)
+            prop3[c] *= sum2 / sum3;
+
+        // stabilize by one more EM step; fall back to the plain EM steps if the likelihood decreased
+        double logl3 = updateWeightsEM(base_prop, prop3, prop1);
+        num_passes++;
+        if (logl3 >= logl) {
+            memcpy(prop, prop1, nmix*sizeof(double));
+            converged = true;
+            for (c = 0; c < nmix; c++)
+                converged = converged && (fabs(prop1[c]-prop3[c]) < 1e-4);
+            if (converged)
+                break;
+        } else
+            memcpy(prop, prop2, nmix*sizeof(double));
     }
 
-    aligned_free(ratio_prop);
-    aligned_free(new_prop);
-//    aligned_free(lk_ptn);
+    if (verbose_mode >= VB_MED)
+        cout << "Mixture weights optimized with " << num_passes << " EM passes" << endl;
+
+    aligned_free(prop3);
+    aligned_free(prop2);
+    aligned_free(prop1);
+    aligned_free(base_prop);
     return phylo_tree->computeLikelihood();
 }
 
@@ -1726,26 +1749,10 @@ double ModelMixture::optimizeWithEM(double gradient_epsilon) {
             break;
         prev_score = score;
 
-        memset(new_prop, 0, nmix*sizeof(double));
-
         // E-step
-        // decoupled weights (prop) from _pattern_lh_cat to obtain L_ci and compute pattern likelihood L_i
-        for (ptn = 0; ptn < nptn; ptn++) {
-            double *this_lk_cat = phylo_tree->_pattern_lh_cat + ptn*nmix;
-            double lk_ptn = phylo_tree->ptn_invar[ptn];
-//            double lk_ptn = 0.0;
-            for (c = 0; c < nmix; c++) {
-                lk_ptn += this_lk_cat[c];
-            }
-            ASSERT(lk_ptn != 0.0);
-            lk_ptn = phylo_tree->ptn_freq[ptn] / lk_ptn;
-
-            // transform _pattern_lh_cat into posterior probabilities of each category
-            for (c = 0; c < nmix; c++) {
-                this_lk_cat[c] *= lk_ptn;
-                new_prop[c] += this_lk_cat[c];
-            }
-        }
+        // decoupled weights (prop) from _pattern_lh_cat to obtain L_ci and compute pattern likelihood L_i,
+        // then transform _pattern_lh_cat into posterior probabilities of each category
+        phylo_tree->computePatternPosteriorCat(nmix, NULL, new_prop, true);
 
         // M-step, update weights according to (*)
 
@@ -203,6 +203,15 @@ public:
     */
     double optimizeWeights();
 
+    /**
+        one EM update of the mixture weights on _pattern_lh_cat
+        @param base_prop weights with which _pattern_lh_cat was computed
+        @param cur_prop current weights
+        @param[out] new_prop updated weights
+        @return log-likelihood of cur_prop, without scaling factors
+    */
+    double updateWeightsEM(double *base_prop, double *cur_prop, double *new_prop);
+
     /** 
         optimize rate parameters using EM algorithm
         @param gradient_epsilon
@@ -560,22 +560,7 @@ double RateFree::optimizeWithEM() {
                 
         // E-step
         // decoupled weights (prop) from _pattern_lh_cat to obtain L_ci and compute pattern likelihood L_i
-        memset(new_prop, 0, nmix*sizeof(double));
-        for (ptn = 0; ptn < nptn; ptn++) {
-            double *this_lk_cat = phylo_tree->_pattern_lh_cat + ptn*nmix;
-            double lk_ptn = phylo_tree->ptn_invar[ptn];
-            for (c = 0; c < nmix; c++) {
-                lk_ptn += this_lk_cat[c];
-            }
-            ASSERT(lk_ptn != 0.0);
-            lk_ptn = phylo_tree->ptn_freq[ptn] / lk_ptn;
-            
-            // transform _pattern_lh_cat into posterior probabilities of each category
-            for (c = 0; c < nmix; c++) {
-                this_lk_cat[c] *= lk_ptn;
-                new_prop[c] += this_lk_cat[c];
-            }
-        }
+        phylo_tree->computePatternPosteriorCat(nmix, NULL, new_prop, true);
         
         // M-step, update weights according to (*)
         int maxpropid = 0;
@@ -238,26 +238,26 @@ int CandidateSet::update(string newTree, double newScore) {
     }
     CandidateTree candidate;
     candidate.score = newScore;
-    candidate.topology = convertTreeString(newTree);
+    candidate.fingerprint = computeFingerprint(newTree);
     candidate.tree = newTree;
 
     int treePos;
     CandidateSet::iterator candidateTreeIt;
 
-    if (treeTopologyExist(candidate.topology)) {
+    if (treeTopologyExist(candidate.fingerprint)) {
         // update new score if it is better the old score
-        double oldScore = topologies[candidate.topology];
+        double oldScore = topologies[candidate.fingerprint];
         if (oldScore < newScore) {
-            removeCandidateTree(candidate.topology);
+            removeCandidateTree(candidate.fingerprint);
             insert(CandidateSet::value_type(newScore, candidate));
-            topologies[candidate.topology] = newScore;
+            topologies[candidate.fingerprint] = newScore;
         }
         ASSERT(topologies.size() == size());
         return -1;
     }
 
     candidateTreeIt = insert(CandidateSet::value_type(newScore, candidate));
-    topologies[candidate.topology] = newScore;
+    topologies[candidate.fingerprint] = newScore;
 
     if (size() > maxSize) {
         removeWorstTree();
@@ -324,7 +324,69 @@ string CandidateSet::getTopology(string tree) {
     return ostr.str();
 }
 
-double CandidateSet::getTopologyScore(string topology) {
+/** 64-bit mixing function (finalizer of splitmix64) */
+static inline uint64_t mixFingerprint(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t CandidateSet::computeFingerprint(const string &tree) {
+    // XOR of the taxon keys of each open subtree
+    vector<uint64_t> subtree;
+    vector<uint64_t> splits;
+    uint64_t all_taxa = 0;
+    size_t pos = 0, len = tree.length();
+    while (pos < len) {
+        char c = tree[pos];
+        if (c == '(') {
+            subtree.push_back(0);
+            pos++;
+        } else if (c == ')') {
+            ASSERT(!subtree.empty());
+            uint64_t clade = subtree.back();
+            subtree.pop_back();
+            pos++;
+            if (subtree.empty())
+                break;
+            subtree.back() ^= clade;
+            splits.push_back(clade);
+            // skip internal node label and branch length
+            while (pos < len && tree[pos] != ',' && tree[pos] != ')' && tree[pos] != ';')
+                pos++;
+        } else if (c == ',' || isspace(c)) {
+            pos++;
+        } else if (c == ':') {
+            // branch length of a taxon
+            while (pos < len && tree[pos] != ',' && tree[pos] != ')' && tree[pos] != ';')
+                pos++;
+        } else if (c == ';') {
+            break;
+        } else {
+            // taxon name, hashed by FNV-1a
+            uint64_t key = 0xcbf29ce484222325ULL;
+            while (pos < len && tree[pos] != ':' && tree[pos] != ',' && tree[pos] != ')' && tree[pos] != '(') {
+                key = (key ^ (unsigned char)tree[pos]) * 0x100000001b3ULL;
+                pos++;
+            }
+            key = mixFingerprint(key);
+            all_taxa ^= key;
+            if (!subtree.empty())
+                subtree.back() ^= key;
+        }
+    }
+    // the string may be rooted anywhere: identify a split by its side with the smaller key,
+    // a root on a branch makes the two clades below it contribute the same split twice
+    uint64_t fingerprint = 0;
+    for (uint64_t clade : splits)
+        fingerprint += mixFingerprint(min(clade, clade ^ all_taxa) + 1);
+    return fingerprint;
+}
+
+double CandidateSet::getTopologyScore(uint64_t topology) {
     ASSERT(topologies.find(topology) != topologies.end());
     return topologies[topology];
 }
@@ -364,23 +426,23 @@ void CandidateSet::getAllTrees(vector<string> &trees, vector<double> &scores, in
     }
 }
 
-bool CandidateSet::treeTopologyExist(string topo) {
+bool CandidateSet::treeTopologyExist(uint64_t topo) {
     return (topologies.find(topo) != topologies.end());
 }
 
 bool CandidateSet::treeExist(string tree) {
-    return treeTopologyExist(convertTreeString(tree));
+    return treeTopologyExist(computeFingerprint(tree));
 }
 
-CandidateSet::iterator CandidateSet::getCandidateTree(string topology) {
+CandidateSet::iterator CandidateSet::getCandidateTree(uint64_t topology) {
     for (CandidateSet::reverse_iterator rit = rbegin(); rit != rend(); rit++) {
-        if (rit->second.topology == topology)
+        if (rit->second.fingerprint == topology)
             return --(rit.base());
     }
     return end();
 }
 
-void CandidateSet::removeCandidateTree(string topology) {
+void CandidateSet::removeCandidateTree(uint64_t topology) {
     bool removed = false;
     double treeScore;
     // Find the score of the topology
@@ -392,7 +454,7 @@ void CandidateSet::removeCandidateTree(string topology) {
     treeItPair = equal_range(treeScore);
     CandidateSet::iterator it;
     for (it = treeItPair.first; it != treeItPair.second; ++it) {
-        if (it->second.topology == topology) {
+        if (it->second.fingerprint == topology) {
             erase(it);
             removed = true;
             break;
@@ -403,7 +465,7 @@ void CandidateSet::removeCandidateTree(string topology) {
 
 
 void CandidateSet::removeWorstTree() {
-    topologies.erase(begin()->second.topology);
+    topologies.erase(begin()->second.fingerprint);
     erase(begin());
 }
 
@@ -501,7 +563,7 @@ void CandidateSet::printTrees(string suffix) {
     outLHs.precision(15);
     for (reverse_iterator rit = rbegin(); rit != rend(); rit++) {
         outLHs << rit->first << endl;
-        outTrees << rit->second.topology << endl;
+        outTrees << convertTreeString(rit->second.tree) << endl;
     }
     outTrees.close();
     outLHs.close();
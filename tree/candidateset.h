@@ -41,11 +41,9 @@ struct CandidateTree {
 	string tree;
 
 	/**
-	 * tree topology WITHOUT branch lengths
-	 * and WITH TAXON ID (instead of taxon names)
-	 * for sorting purpose
+	 * fingerprint of the tree topology, see CandidateSet::computeFingerprint()
 	 */
-	string topology;
+	uint64_t fingerprint;
 
 	/**
 	 * log-likelihood or parsimony score
@@ -182,9 +180,9 @@ public:
      * 	Check if tree topology \a topo already exists
      *
      * 	@param topo
-     * 		Newick string of the tree topology
+     * 		fingerprint of the tree topology
      */
-    bool treeTopologyExist(string topo);
+    bool treeTopologyExist(uint64_t topo);
 
     /**
      * 	Check if tree \a tree already exists
@@ -217,16 +215,31 @@ public:
      * 		Newick string of the tree topology
      */
     string getTopology(string tree);
-    
+
+    /**
+     *  Compute a 64-bit fingerprint of the topology of a tree in a single pass over its NEWICK string,
+     *  without building the tree. Every taxon gets a random-like key from its name, every split
+     *  is identified by the XOR of the keys on one side and the fingerprint is the sum of the
+     *  hashed splits. Thus it does not depend on the order of subtrees or the position of the root
+     *  in the string, and a different topology gets the same fingerprint only with
+     *  probability about 2^-64.
+     *
+     *  @param tree
+     *  	NEWICK string, e.g. from PhyloTree::getTreeString()
+     *  @return
+     *  	fingerprint of the topology
+     */
+    static uint64_t computeFingerprint(const string &tree);
+
     /**
      * return the score of \a topology
      *
      * @param topology
-     * 		Newick topology
+     * 		fingerprint of the topology
      * @return
      * 		Score of the topology
      */
-    double getTopologyScore(string topology);
+    double getTopologyScore(uint64_t topology);
 
     /**
      *  Empty the candidate set
@@ -272,16 +285,16 @@ public:
 
     /**
      * Return a pointer to the \a CandidateTree that has topology equal to \a topology
-     * @param topology
+     * @param topology fingerprint of the topology
      * @return
      */
-    iterator getCandidateTree(string topology);
+    iterator getCandidateTree(uint64_t topology);
 
     /**
      * Remove candidate trees with topology equal to the specified topology
-     * @param topology
+     * @param topology fingerprint of the topology
      */
-    void removeCandidateTree(string topology);
+    void removeCandidateTree(uint64_t topology);
 
     /**
      *  Remove the worst tree in the candidate set
@@ -291,7 +304,7 @@ public:
     /* Getter and Setter function */
 	void setAln(Alignment* aln);
 
-	const StringDoubleHashMap& getTopologies() const {
+	const unordered_map<uint64_t, double>& getTopologies() const {
 		return topologies;
 	}
 
@@ -378,9 +391,9 @@ private:
 	SplitIntMap candSplits;
 
     /**
-     *  Map data structure storing <topology_string, score>
+     *  Map data structure storing <topology fingerprint, score>
      */
-    StringDoubleHashMap topologies;
+    unordered_map<uint64_t, double> topologies;
 
     /**
      *  Trees used for reproduction
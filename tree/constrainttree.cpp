@@ -83,6 +83,7 @@ void ConstraintTree::initFromTree() {
     taxname_index.clear();
     for (it = taxname.begin(); it != taxname.end(); it++)
         taxname_index[(*it)] = it - taxname.begin();
+    leaf_taxon_id.clear();
 
     // convert into split system
     SplitGraph sg;
@@ -121,6 +122,32 @@ int ConstraintTree::removeTaxa(StrVector &taxa_names) {
     return count;
 }
 
+int ConstraintTree::getTaxonID(Node *leaf) {
+    if (leaf->id >= leaf_taxon_id.size())
+        leaf_taxon_id.resize(leaf->id+1, -2);
+    int &taxon_id = leaf_taxon_id[leaf->id];
+    if (taxon_id == -2) {
+        StringIntMap::iterator mit = taxname_index.find(leaf->name);
+        taxon_id = (mit != taxname_index.end()) ? mit->second : -1;
+    }
+    return taxon_id;
+}
+
+int ConstraintTree::getTaxonSet(Split &taxset, Node *node, Node *dad) {
+    int count = 0;
+    if (node->isLeaf()) {
+        int taxon_id = getTaxonID(node);
+        if (taxon_id >= 0) {
+            taxset.addTaxon(taxon_id);
+            count++;
+        }
+    }
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        count += getTaxonSet(taxset, (*it)->node, node);
+    }
+    return count;
+}
+
 bool ConstraintTree::isCompatible(StrVector &tax1, StrVector &tax2) {
 
     ASSERT(!empty());
@@ -142,8 +169,6 @@ bool ConstraintTree::isCompatible(StrVector &tax1, StrVector &tax2) {
             tax_count1++;
             sp1.addTaxon(mit->second);
         }
-    if (tax_count1 <= 1)
-        return true;
         
     int tax_count2 = 0;
     for (it = tax2.begin(); it != tax2.end(); it++)
@@ -153,53 +178,48 @@ bool ConstraintTree::isCompatible(StrVector &tax1, StrVector &tax2) {
             sp2.addTaxon(mit->second);
         }
     
-    if (tax_count2 <= 1) 
+    return isCompatible(sp1, sp2, tax_count1, tax_count2);
+}
+
+bool ConstraintTree::isCompatible(Split &taxset1, Split &taxset2, int count1, int count2) {
+
+    if (count1 <= 1 || count2 <= 1)
         return true;
-    
-    if (tax_count1 + tax_count2 == leafNum) {
-        // tax1 and tax2 form all taxa in the constraint tree
-        
+
+    if (count1 + count2 == leafNum) {
+        // taxset1 and taxset2 form all taxa in the constraint tree:
         // quick check if this split is contained in the tree
-        Split *res = NULL;
-        if (sp1.containTaxon(0))
-            res = findSplit(&sp1);
-        else
-            res = findSplit(&sp2);
-        if (res) return true;
-        
-        // otherwise, check for compatibility with all splits
-        for (iterator sit = begin(); sit != end(); sit++)
-            if (!sit->first->compatible(sp1))
-               return false;
-        return true;
-    } else {
-        // partial split
-        ASSERT(tax_count1 + tax_count2 < leafNum);
-        Split taxa_mask(sp1);
-        taxa_mask += sp2;
-        Split* subsp = sp1.extractSubSplit(taxa_mask);
-        bool res = true;
-        for (iterator sit = begin(); sit != end(); sit++) {
-            Split *subit = sit->first->extractSubSplit(taxa_mask);
-            if (!subit->compatible(*subsp)) {
-                res = false;
-                delete subit;
-                break;
-            }
-            delete subit;
+        if (findSplit(taxset1.containTaxon(0) ? &taxset1 : &taxset2))
+            return true;
+    }
+
+    // the split is compatible with a constraint split S unless all of
+    // taxset1 & S, taxset1 & ~S, taxset2 & S and taxset2 & ~S are non-empty.
+    // Taxa outside taxset1 and taxset2 are thereby ignored
+    ASSERT(count1 + count2 <= leafNum);
+    size_t num_words = taxset1.size();
+    for (iterator sit = begin(); sit != end(); sit++) {
+        Split &sp = *sit->first;
+        UINT res1 = 0, res2 = 0, res3 = 0, res4 = 0;
+        for (size_t i = 0; i < num_words; i++) {
+            res1 |= sp[i] & taxset1[i];
+            res2 |= ~sp[i] & taxset1[i];
+            res3 |= sp[i] & taxset2[i];
+            res4 |= ~sp[i] & taxset2[i];
         }
-        delete subsp;
-        return res;
+        if (res1 && res2 && res3 && res4)
+            return false;
     }
+    return true;
 }
 
 bool ConstraintTree::isCompatible(Node *node1, Node *node2) {
     if (empty())
         return true;
-    StrVector taxset1, taxset2;
-    getUnorderedTaxaName(taxset1, node1, node2);
-    getUnorderedTaxaName(taxset2, node2, node1);
-    return isCompatible(taxset1, taxset2);
+    Split taxset1(leafNum), taxset2(leafNum);
+    int count1 = getTaxonSet(taxset1, node1, node2);
+    int count2 = getTaxonSet(taxset2, node2, node1);
+    return isCompatible(taxset1, taxset2, count1, count2);
 }
 
 bool ConstraintTree::isCompatible (MTree *tree) {
@@ -208,15 +228,10 @@ bool ConstraintTree::isCompatible (MTree *tree) {
     NodeVector nodes1, nodes2;
     tree->generateNNIBraches(nodes1, nodes2);
 //    tree->getAllInnerBranches(nodes1, nodes2);
-    StrVector taxset1, taxset2;
     
     // check that all internal branches are compatible with constraint
     for (int i = 0; i < nodes1.size(); i++) {
-        taxset1.clear();
-        taxset2.clear();
-        getUnorderedTaxaName(taxset1, nodes1[i], nodes2[i]);
-        getUnorderedTaxaName(taxset2, nodes2[i], nodes1[i]);
-        if (!isCompatible(taxset1, taxset2))
+        if (!isCompatible(nodes1[i], nodes2[i]))
             return false;
     }
     return true;
@@ -228,26 +243,24 @@ bool ConstraintTree::isCompatible(NNIMove &nni) {
     if (empty())
         return true;
     // check for consistency with constraint tree
-    StrVector taxset1, taxset2;
+    Split taxset1(leafNum), taxset2(leafNum);
+    int count1 = 0, count2 = 0;
     
     // get taxa set 1 (below node1)
     FOR_NEIGHBOR_DECLARE(nni.node1, nni.node2, it)
         if (it != nni.node1Nei_it) {
-            getUnorderedTaxaName(taxset1, (*it)->node, nni.node1);
+            count1 += getTaxonSet(taxset1, (*it)->node, nni.node1);
         }
     //taxset1 also includes taxa below node2Nei_it if doing NNI 
-    getUnorderedTaxaName(taxset1, (*nni.node2Nei_it)->node, nni.node2);
+    count1 += getTaxonSet(taxset1, (*nni.node2Nei_it)->node, nni.node2);
     
-    // get taxa set 1 (below node1)
+    // get taxa set 2 (below node2)
     FOR_NEIGHBOR(nni.node2, nni.node1, it)
         if (it != nni.node2Nei_it) {
-            getUnorderedTaxaName(taxset2, (*it)->node, nni.node2);
+            count2 += getTaxonSet(taxset2, (*it)->node, nni.node2);
         }
     //taxset2 also includes taxa below node1Nei_it if doing NNI 
-    getUnorderedTaxaName(taxset2, (*nni.node1Nei_it)->node, nni.node1);
-    
-//        getUnorderedTaxaName(taxset1, node1, node2);
-//        getUnorderedTaxaName(taxset2, node2, node1);
+    count2 += getTaxonSet(taxset2, (*nni.node1Nei_it)->node, nni.node1);
 
-    return isCompatible(taxset1, taxset2);
+    return isCompatible(taxset1, taxset2, count1, count2);
 }
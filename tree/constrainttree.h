@@ -62,6 +62,16 @@ public:
      */ 
     bool isCompatible(StrVector &tax1, StrVector &tax2);
 
+    /**
+        check if a "partial" split defined by two taxon sets is compatible with the constraint tree.
+        @param[in] taxset1 constraint taxa in one side of split, with leafNum bits
+        @param[in] taxset2 constraint taxa in other side of split, with leafNum bits
+        @param count1 number of taxa in taxset1
+        @param count2 number of taxa in taxset2
+        @return true if the split is compatible with all splits in the constraint tree, false otherwise.
+     */
+    bool isCompatible(Split &taxset1, Split &taxset2, int count1, int count2);
+
     /**
         check if a branch defined by two nodes in any tree is compatible or not
         @param node1 one end node of the branch
@@ -92,11 +102,32 @@ public:
         return taxname_index.find(taxname) != taxname_index.end();
     }
 
+    /**
+        add the constraint taxa of a subtree of a working tree to a taxon set
+        @param[in,out] taxset taxon set with leafNum bits
+        @param node root of the subtree
+        @param dad the node above the subtree
+        @return number of taxa added
+    */
+    int getTaxonSet(Split &taxset, Node *node, Node *dad);
+
 protected:
 
     /* map from taxon name to its index, used for quick taxon name search */
     StringIntMap taxname_index;
 
+    /**
+        map from leaf ID of the working tree to constraint taxon ID (-1 if the taxon is
+        not in the constraint tree), filled on demand such that taxon names are only looked up once
+    */
+    IntVector leaf_taxon_id;
+
+    /**
+        @param leaf a leaf of the working tree
+        @return ID of the leaf in the constraint tree, -1 if not found
+    */
+    int getTaxonID(Node *leaf);
+
 };
 
 #endif
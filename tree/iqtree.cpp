@@ -1614,7 +1614,7 @@ string IQTree::perturbStableSplits(double suppValue) {
     return getTreeString();
 }
 
-string IQTree::doRandomNNIs(bool storeTabu) {
+string IQTree::doRandomNNIs(bool storeTabu, int *rstream, bool clearLH) {
     int cntNNI = 0;
     int numRandomNNI;
     Branches nniBranches;
@@ -1641,8 +1641,8 @@ string IQTree::doRandomNNIs(bool storeTabu) {
         for (Branches::iterator it = nniBranches.begin(); it != nniBranches.end(); ++it) {
             vectorNNIBranches.push_back(it->second);
         }
-        int randInt = random_int((int) vectorNNIBranches.size());
-        NNIMove randNNI = getRandomNNI(vectorNNIBranches[randInt]);
+        int randInt = random_int((int) vectorNNIBranches.size(), rstream);
+        NNIMove randNNI = getRandomNNI(vectorNNIBranches[randInt], rstream);
         if (constraintTree.isCompatible(randNNI)) {
             // only if random NNI satisfies constraintTree
             doNNI(randNNI);
@@ -1669,7 +1669,10 @@ string IQTree::doRandomNNIs(bool storeTabu) {
         pllReadNewick(getTreeString());
     }
 
-    clearAllPartialLH();
+    if (clearLH)
+        clearAllPartialLH();
+    else
+        current_it = current_it_back = NULL;
     resetCurScore();
     return getTreeString();
 }
@@ -2277,6 +2280,9 @@ double IQTree::doTreeSearch() {
     int ufboot_count, ufboot_count_check;
     stop_rule.getUFBootCountCheck(ufboot_count, ufboot_count_check);
 
+    if (!early_stop)
+        initWalkers();
+
     while (!stop_rule.meetStopCondition(stop_rule.getCurIt(), cur_correlation)) {
 
         searchinfo.curIter = stop_rule.getCurIt();
@@ -2301,11 +2307,15 @@ double IQTree::doTreeSearch() {
          * Optimize tree with NNI
          *----------------------------------------*/
         pair<int, int> nniInfos; // <num_NNIs, num_steps>
-        nniInfos = doNNISearch();
-        curTree = getTreeString();
-        int pos = addTreeToCandidateSet(curTree, curScore, true, MPIHelper::getInstance().getProcessID());
-        if (pos != -2 && pos != -1 && (Params::getInstance().fixStableSplits || Params::getInstance().adaptPertubation))
-            candidateTrees.computeSplitOccurences(Params::getInstance().stableSplitThreshold);
+        if (!walkers.empty()) {
+            doWalkerRound();
+        } else {
+            nniInfos = doNNISearch();
+            curTree = getTreeString();
+            int pos = addTreeToCandidateSet(curTree, curScore, true, MPIHelper::getInstance().getProcessID());
+            if (pos != -2 && pos != -1 && (Params::getInstance().fixStableSplits || Params::getInstance().adaptPertubation))
+                candidateTrees.computeSplitOccurences(Params::getInstance().stableSplitThreshold);
+        }
 
         if (MPIHelper::getInstance().isWorker() || MPIHelper::getInstance().gotMessage())
             syncCurrentTree();
@@ -2404,6 +2414,8 @@ double IQTree::doTreeSearch() {
     
     if(params->ufboot2corr) refineBootTrees();
 
+    deleteWalkers();
+
     if (!early_stop)
         sendStopMessage();
 
@@ -3088,7 +3100,10 @@ pair<int, int> IQTree::optimizeNNI(bool speedNNI) {
 
         // do non-conflicting positive NNIs
         doNNIs(appliedNNIs);
-        curScore = optimizeAllBranches(1, params->loglh_epsilon, PLL_NEWZPERCYCLE);
+        if (params->local_nni_brlen)
+            curScore = optimizeBranchesAroundNNIs(appliedNNIs, params->loglh_epsilon, PLL_NEWZPERCYCLE);
+        else
+            curScore = optimizeAllBranches(1, params->loglh_epsilon, PLL_NEWZPERCYCLE);
 
         if (curScore < appliedNNIs.at(0).newloglh - params->loglh_epsilon) {
             //cout << "Tree getting worse: curScore = " << curScore << " / best score = " <<  appliedNNIs.at(0).newloglh << endl;
@@ -3435,6 +3450,50 @@ double IQTree::optimizeNNIBranches(Branches &nniBranches) {
     return curScore;
 }
 
+double IQTree::optimizeBranchesAroundNNIs(vector<NNIMove> &appliedNNIs, double tolerance, int maxNRStep) {
+    // depth-first from each NNI, such that consecutive branches are mostly adjacent
+    // and only few partial likelihoods have to be recomputed in between
+    vector<Branch> stack;
+    set<int> nni_branches, visited;
+    NeighborVec::iterator it;
+    for (vector<NNIMove>::reverse_iterator nni = appliedNNIs.rbegin(); nni != appliedNNIs.rend(); nni++) {
+        stack.push_back(Branch(nni->node1, nni->node2));
+        nni_branches.insert(pairInteger(nni->node1->id, nni->node2->id));
+    }
+    double tree_lh = -DBL_MAX;
+    int num_optimized = 0;
+    while (!stack.empty()) {
+        Node *node1 = stack.back().first;
+        Node *node2 = stack.back().second;
+        stack.pop_back();
+        int branch_id = pairInteger(node1->id, node2->id);
+        if (!visited.insert(branch_id).second)
+            continue;
+        optimizeOneBranch((PhyloNode*) node1, (PhyloNode*) node2, true, maxNRStep);
+        num_optimized++;
+        double new_lh = computeLikelihoodFromBuffer();
+        // the branches adjacent to an NNI are always optimized, further branches
+        // only as long as the likelihood improves
+        bool improved = (new_lh > tree_lh + tolerance);
+        tree_lh = new_lh;
+        if (!improved && nni_branches.find(branch_id) == nni_branches.end())
+            continue;
+        FOR_NEIGHBOR(node1, node2, it)
+            if (visited.find(pairInteger(node1->id, (*it)->node->id)) == visited.end())
+                stack.push_back(Branch(node1, (*it)->node));
+        FOR_NEIGHBOR(node2, node1, it)
+            if (visited.find(pairInteger(node2->id, (*it)->node->id)) == visited.end())
+                stack.push_back(Branch(node2, (*it)->node));
+    }
+    if (verbose_mode >= VB_MAX) {
+        hideProgress();
+        cout << num_optimized << " branches optimized around " << appliedNNIs.size() << " NNIs" << endl;
+        showProgress();
+    }
+    curScore = tree_lh;
+    return curScore;
+}
+
 /**
  *  Currently not used, commented out to simplify the interface of getBestNNIForBran
 void IQTree::evalNNIsSort(bool approx_nni) {
@@ -3770,7 +3829,7 @@ void IQTree::writeUFBootTrees(Params &params) {
     int i, j;
     string filename = params.out_prefix;
     filename += ".ufboot";
-    ofstream out(filename.c_str());
+    AsyncOutputStream out(filename.c_str());
 
     trees.init(boot_trees, rooted);
     for (i = 0; i < trees.size(); i++) {
@@ -4494,6 +4553,149 @@ void IQTree::sendStopMessage() {
 #endif
 }
 
+/** #patterns x #states per kernel thread of a walker for --walkers AUTO */
+#define WALKER_PATTERN_STATES_PER_THREAD 4000
+
+void IQTree::initWalkers() {
+    int num_walkers = params->num_walkers;
+    if (num_walkers == 1)
+        return;
+#ifdef _OPENMP
+    string unsupported;
+    if (MPIHelper::getInstance().getNumProcesses() > 1)
+        unsupported = "MPI";
+    else if (isSuperTree() || isMixlen())
+        unsupported = "partition or mixture branch length models";
+    else if (params->gbo_replicates > 0)
+        unsupported = "ultrafast bootstrap";
+    else if (params->pll || !params->snni || params->iqp || params->adaptPertubation || params->fixStableSplits ||
+             params->five_plus_five || iqp_assess_quartet == IQP_BOOTSTRAP)
+        unsupported = "this tree search variant";
+    else if (params->write_intermediate_trees || params->writeDistImdTrees || params->print_tree_lh ||
+             params->print_trees_site_posterior || params->store_trans_matrix)
+        unsupported = "writing intermediate trees or likelihoods";
+    if (!unsupported.empty()) {
+        if (num_walkers > 1)
+            outWarning("Multiple tree search walkers are not supported with " + unsupported);
+        return;
+    }
+
+    int threads_per_walker;
+    if (num_walkers == 0) {
+        // give each walker as many kernel threads as its patterns can keep busy
+        size_t ptn_states = getAlnNPattern() * aln->num_states;
+        threads_per_walker = max(1, min(num_threads, (int)(ptn_states / WALKER_PATTERN_STATES_PER_THREAD)));
+        num_walkers = num_threads / threads_per_walker;
+    } else {
+        if (num_walkers > num_threads)
+            num_walkers = num_threads;
+        threads_per_walker = max(1, num_threads / num_walkers);
+    }
+
+    // every walker holds its own likelihood vectors
+    uint64_t mem_required = getMemoryRequired();
+    uint64_t total_mem = getMemorySize();
+    if (mem_required > 0 && (num_walkers+1) * mem_required > total_mem * 0.95) {
+        num_walkers = max(1, (int)(total_mem * 0.95 / mem_required) - 1);
+        cout << "NOTE: Number of tree search walkers reduced to " << num_walkers << " due to RAM limit" << endl;
+    }
+    if (num_walkers <= 1)
+        return;
+
+    cout << "Tree search with " << num_walkers << " walkers, " << threads_per_walker
+         << " threads per walker" << endl;
+    string tree_string = getTreeString();
+    for (int w = 0; w < num_walkers; w++) {
+        IQTree *walker = new IQTree(aln);
+        walker->setParams(params);
+        walker->rooted = rooted;
+        if (!constraintTree.empty())
+            walker->constraintTree.readConstraint(constraintTree);
+        walker->searchinfo.nni_type = params->nni_type;
+        walker->optimize_by_newton = optimize_by_newton;
+        walker->sse = sse;
+        walker->setNumThreads(threads_per_walker);
+        walker->setModelFactory(getModelFactory());
+        walker->readTreeString(tree_string);
+        walker->initializeAllPartialLh();
+        walkers.push_back(walker);
+        walker_trees.push_back("");
+        // seed from the main stream, such that walkers do not repeat the parsimony streams
+        int *rstream;
+        init_random(params->ran_seed + random_int(1000000000), false, &rstream);
+        walker_rstreams.push_back(rstream);
+    }
+#else
+    if (num_walkers > 1)
+        outWarning("Multiple tree search walkers need the multi-threaded version");
+#endif
+}
+
+void IQTree::doWalkerRound() {
+    int num_walkers = walkers.size();
+    StrVector trees(num_walkers);
+    DoubleVector scores(num_walkers);
+    for (int w = 0; w < num_walkers; w++)
+        trees[w] = candidateTrees.getRandTopTree(params->popSize);
+
+#ifdef _OPENMP
+    // walkers with several threads run the likelihood kernel in nested parallel regions
+    omp_set_nested(walkers[0]->num_threads > 1);
+    #pragma omp parallel for schedule(dynamic) num_threads(num_walkers)
+#endif
+    for (int w = 0; w < num_walkers; w++) {
+        IQTree *walker = walkers[w];
+        // switch to the drawn tree in place if the walker holds it already, keeping the
+        // partial likelihoods of the subtrees not touched by the perturbation
+        bool in_place = (trees[w] == walker_trees[w]);
+        if (!in_place) {
+            walker->readTreeString(trees[w]);
+            walker->initializeAllPartialLh();
+        }
+        walker->doRandomNNIs(params->tabu, walker_rstreams[w], !in_place);
+        walker->computeLogL();
+        walker->optimizeNNI(params->speednni);
+        trees[w] = walker->getTreeString();
+        scores[w] = walker->getCurScore();
+        walker_trees[w] = trees[w];
+    }
+#ifdef _OPENMP
+    omp_set_nested(false);
+#endif
+
+    double best_score = candidateTrees.getBestScore();
+    for (int w = 0; w < num_walkers; w++)
+        addTreeToCandidateSet(trees[w], scores[w], true, MPIHelper::getInstance().getProcessID());
+    MPIHelper::getInstance().setNumNNISearch(MPIHelper::getInstance().getNumNNISearch() + num_walkers);
+
+    // as in doNNISearch: re-optimize model parameters if a better tree is found.
+    // The walkers only read the model, which therefore must not change during the round
+    if (candidateTrees.getBestScore() > best_score + params->modelEps) {
+        readTreeString(candidateTrees.getBestTreeStrings(1)[0]);
+        initializeAllPartialLh();
+        optimizeModelParameters(false, params->modelEps * 10);
+        getModelFactory()->saveCheckpoint();
+        // partial likelihoods of the walkers are outdated
+        for (int w = 0; w < num_walkers; w++)
+            walker_trees[w].clear();
+        if (rooted && params->root_move_dist > 0)
+            optimizeRootPosition(params->root_move_dist, true, params->modelEps * 10);
+        addTreeToCandidateSet(getTreeString(), curScore, false, MPIHelper::getInstance().getProcessID());
+    }
+}
+
+void IQTree::deleteWalkers() {
+    for (int w = 0; w < walkers.size(); w++) {
+        // model is owned by this tree
+        walkers[w]->setModelFactory(NULL);
+        delete walkers[w];
+        finish_random(walker_rstreams[w]);
+    }
+    walkers.clear();
+    walker_rstreams.clear();
+    walker_trees.clear();
+}
+
 void PhyloTree::warnNumThreads() {
     if (num_threads <= 1)
         return;
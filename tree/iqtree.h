@@ -33,6 +33,7 @@
 #include "node.h"
 #include "candidateset.h"
 #include "utils/pllnni.h"
+#include "utils/asyncstream.h"
 
 typedef std::map< string, double > mapString2Double;
 typedef std::multiset< double, std::less< double > > multiSetDB;
@@ -248,9 +249,12 @@ public:
 
     /**
      *         Perform a series of random NNI moves
+     *         @param rstream random number stream, NULL to use the global one
+     *         @param clearLH true to clear all partial likelihoods, false to only clear those
+     *         invalidated by the NNIs (tree not re-read since they were computed)
      *         @return the perturbed newick string
      */
-    string doRandomNNIs(bool storeTabu = false);
+    string doRandomNNIs(bool storeTabu = false, int *rstream = NULL, bool clearLH = true);
 
     /**
      *  Do a random NNI on splits that are shared among all the candidate trees.
@@ -451,6 +455,18 @@ public:
 
     double optimizeNNIBranches(Branches &nniBranches);
 
+    /**
+     * @brief Optimize branch lengths around the applied NNIs. Starting from the branches
+     * adjacent to the NNIs, the sweep moves outward along branches whose optimization
+     * improves the log-likelihood by more than \a tolerance
+     *
+     * @param appliedNNIs [IN] the NNIs just applied to the tree
+     * @param tolerance log-likelihood improvement to continue with the neighboring branches
+     * @param maxNRStep maximum number of Newton-Raphson steps per branch
+     * @return the tree log-likelihood
+     */
+    double optimizeBranchesAroundNNIs(vector<NNIMove> &appliedNNIs, double tolerance, int maxNRStep);
+
     /**
             search all positive NNI move on the current tree and save them
             on the possilbleNNIMoves list
@@ -704,6 +720,26 @@ public:
     */
     void sendStopMessage();
 
+    /**
+        create the search walkers for the multi-walker tree search (--walkers).
+        Walkers are IQTree objects sharing the alignment and the model of this tree,
+        each with its own likelihood buffers and random number stream.
+        The number of walkers and kernel threads per walker is chosen from the pattern count
+        if not given. No walkers are created if the search does not support it.
+    */
+    void initWalkers();
+
+    /**
+        one round of the multi-walker tree search: every walker perturbs a tree drawn from the
+        candidate set and optimizes it by NNI, in parallel. The resulting trees are added to the
+        candidate set in walker order afterwards, so the search is reproducible for a given
+        number of walkers. Model parameters are re-optimized on the best tree if it improved.
+    */
+    void doWalkerRound();
+
+    /** delete the search walkers */
+    void deleteWalkers();
+
     /**
      *  Generate the initial parsimony/random trees, called by initCandidateTreeSet
      *  @param nParTrees number of parsimony/random trees to generate
@@ -860,7 +896,8 @@ protected:
 
     //int write_intermediate_trees;
 
-    ofstream out_treels, out_treelh, out_sitelh, out_treebetter;
+    AsyncOutputStream out_treels, out_treelh, out_sitelh;
+    ofstream out_treebetter;
     string treels_name, out_lh_file, site_lh_file;
 
     void estimateNNICutoff(Params* params);
@@ -878,6 +915,15 @@ protected:
     // true if best candidate tree is changed
     bool bestcandidate_changed;
 
+    /** search walkers of the multi-walker tree search, empty for the single-walker search */
+    vector<IQTree*> walkers;
+
+    /** random number streams of the walkers */
+    vector<int*> walker_rstreams;
+
+    /** tree strings last produced by the walkers, empty if the walker must re-read its next tree */
+    StrVector walker_trees;
+
     /**
             number of IQPNNI iterations
      */
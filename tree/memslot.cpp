@@ -25,6 +25,12 @@
 const int MEM_LOCKED = 1;
 const int MEM_SPECIAL = 2;
 
+MemSlotVector::MemSlotVector() {
+    free_count = 0;
+    access_count = 0;
+    num_allocations = num_evictions = evicted_size = 0;
+}
+
 void MemSlotVector::init(PhyloTree *tree, int num_slot) {
     if (Params::getInstance().lh_mem_save != LM_MEM_SAVE)
         return;
@@ -50,6 +56,20 @@ void MemSlotVector::reset() {
     free_count = 0;
 }
 
+void MemSlotVector::touch(iterator it) {
+    it->last_used = ++access_count;
+}
+
+void MemSlotVector::printStats(ostream &out) {
+    if (Params::getInstance().lh_mem_save != LM_MEM_SAVE)
+        return;
+    out << "Partial likelihood slots: " << size() << ", allocations: " << num_allocations
+        << ", evictions: " << num_evictions;
+    if (num_evictions > 0)
+        out << " (avg. subtree size " << (double)evicted_size / num_evictions << ")";
+    out << endl;
+}
+
 
 MemSlotVector::iterator MemSlotVector::findNei(PhyloNeighbor *nei) {
     auto it = nei_id_map.find(nei);
@@ -64,6 +84,8 @@ void MemSlotVector::addNei(PhyloNeighbor *nei, iterator it) {
     nei->scale_num = it->scale_num;
     it->nei = nei;
     nei_id_map[nei] = it-begin();
+    touch(it);
+    num_allocations++;
 }
 
 
@@ -75,6 +97,7 @@ void MemSlotVector::addSpecialNei(PhyloNeighbor *nei) {
     ms.nei = nei;
     ms.partial_lh = nei->partial_lh;
     ms.scale_num = nei->scale_num;
+    ms.last_used = ++access_count;
     push_back(ms);
     nei_id_map[nei] = size()-1;
 }
@@ -99,6 +122,7 @@ bool MemSlotVector::lock(PhyloNeighbor *nei) {
         return false;
     ASSERT((id->status & MEM_LOCKED) == 0);
     id->status |= MEM_LOCKED;
+    touch(id);
     return true;
 }
 
@@ -144,22 +168,25 @@ int MemSlotVector::allocate(PhyloNeighbor *nei) {
     }
 
     int min_size = INT_MAX;
+    int64_t min_used = 0;
     iterator best = end();
 
-
-    // no free slot found, find an unlocked slot with minimal size
+    // no free slot found, find an unlocked slot with minimal size, which is the cheapest
+    // to recompute. Among those, take the least recently used one
     for (iterator it = begin(); it != end(); it++)
-        if ((it->status & MEM_LOCKED) == 0 && (it->status & MEM_SPECIAL) == 0 && min_size > it->nei->size) {
+        if ((it->status & MEM_LOCKED) == 0 && (it->status & MEM_SPECIAL) == 0 &&
+            (min_size > it->nei->size || (min_size == it->nei->size && min_used > it->last_used))) {
             best = it;
             min_size = it->nei->size;
-            // 2 is the minimum size
-            if (min_size == 2)
-                break;
+            min_used = it->last_used;
         }
 
     if (best == end())
         return -1;
 
+    num_evictions++;
+    evicted_size += best->nei->size;
+
     // clear mem assigned to it->nei
     best->nei->clearPartialLh();
 
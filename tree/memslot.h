@@ -34,6 +34,7 @@ struct MemSlot {
     PhyloNeighbor *nei; // neighbor assigned to this slot
     double *partial_lh; // partial_lh assigned to this slot
     UBYTE *scale_num; // scale_num assigned to this slot
+    int64_t last_used; // time stamp of the last access, see MemSlotVector::allocate
 
     PhyloNeighbor *saved_nei;
 };
@@ -44,6 +45,8 @@ struct MemSlot {
 class MemSlotVector : public vector<MemSlot> {
 public:
 
+    MemSlotVector();
+
     /** initialize with a specified number of slots */
     void init(PhyloTree *tree, int num_slot);
 
@@ -87,6 +90,9 @@ public:
     /** erase special neihbor e.g. for NNI */
     void eraseSpecialNei();
 
+    /** print allocation statistics */
+    void printStats(ostream &out);
+
     /** replace a neighbor, used for NNI */
     void replace(PhyloNeighbor *new_nei, PhyloNeighbor *old_nei);
 
@@ -105,6 +111,21 @@ protected:
     /** counter of free slot ID */
     int free_count;
 
+    /** number of slot accesses so far, used as time stamp */
+    int64_t access_count;
+
+    /** number of partial_lh assigned to a slot */
+    int64_t num_allocations;
+
+    /** number of partial_lh evicted from a slot */
+    int64_t num_evictions;
+
+    /** total subtree size of evicted partial_lh, i.e. the work to recompute them */
+    int64_t evicted_size;
+
+    /** update the time stamp of a slot when its partial_lh is accessed */
+    void touch(iterator it);
+
 };
 
 
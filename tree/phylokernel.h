@@ -1815,6 +1815,70 @@ int PhyloTree::computeParsimonyBranchFastSIMD(PhyloNeighbor *dad_branch, PhyloNo
     return score;
 }
 
+/**
+    Fitch score of inserting subtree t into the branch between subtrees x and y
+    for one block of sites, computed in registers without storing the partial
+    parsimony of the new node. NSTATES is 0 if the number of states is not known
+    at compile time.
+*/
+template<class VectorClass, const int NSTATES>
+inline UINT computeParsimonyInsertBlock(VectorClass *x, VectorClass *y, VectorClass *t, int nstates) {
+    const int n = NSTATES ? NSTATES : nstates;
+    VectorClass w1 = x[0] & y[0];
+    for (int i = 1; i < n; i++)
+        w1 |= x[i] & y[i];
+    w1 = ~w1;
+    VectorClass w2 = 0;
+    for (int i = 0; i < n; i++)
+        w2 |= ((x[i] & y[i]) | (w1 & (x[i] | y[i]))) & t[i];
+    w2 = ~w2;
+    return fast_popcount(w1) + fast_popcount(w2);
+}
+
+template<class VectorClass, const int NSTATES>
+inline UINT computeParsimonyInsertSites(UINT *x, UINT *y, UINT *t, int nstates, int nsites, UINT score, UINT lower_bound, int num_threads) {
+    const int entry_size = (NSTATES ? NSTATES : nstates) * VectorClass::size();
+#ifdef _OPENMP
+    if (num_threads > 1 && nsites > num_threads*10) {
+        #pragma omp parallel for reduction(+: score)
+        for (int site = 0; site < nsites; site++) {
+            size_t offset = entry_size*site;
+            score += computeParsimonyInsertBlock<VectorClass, NSTATES>((VectorClass*)(x + offset),
+                (VectorClass*)(y + offset), (VectorClass*)(t + offset), nstates);
+        }
+        return score;
+    }
+#endif
+    for (int site = 0; site < nsites && score < lower_bound; site++) {
+        size_t offset = entry_size*site;
+        score += computeParsimonyInsertBlock<VectorClass, NSTATES>((VectorClass*)(x + offset),
+            (VectorClass*)(y + offset), (VectorClass*)(t + offset), nstates);
+    }
+    return score;
+}
+
+template<class VectorClass>
+int PhyloTree::computeParsimonyInsertFastSIMD(PhyloNeighbor *taxon_branch, PhyloNeighbor *node_branch, PhyloNeighbor *dad_branch) {
+    int nstates = aln->getMaxNumStates();
+    const int NUM_BITS = VectorClass::size() * UINT_BITS;
+    int nsites = (aln->num_parsimony_sites + NUM_BITS - 1)/NUM_BITS;
+    int scoreid = nsites*nstates*VectorClass::size();
+    UINT *x = node_branch->partial_pars;
+    UINT *y = dad_branch->partial_pars;
+    UINT *t = taxon_branch->partial_pars;
+    UINT score = x[scoreid] + y[scoreid] + t[scoreid];
+    UINT lower_bound = best_pars_score;
+
+    switch (nstates) {
+    case 4:
+        return computeParsimonyInsertSites<VectorClass, 4>(x, y, t, nstates, nsites, score, lower_bound, num_threads);
+    case 20:
+        return computeParsimonyInsertSites<VectorClass, 20>(x, y, t, nstates, nsites, score, lower_bound, num_threads);
+    default:
+        return computeParsimonyInsertSites<VectorClass, 0>(x, y, t, nstates, nsites, score, lower_bound, num_threads);
+    }
+}
+
 /****************************************************************************
  Sankoff parsimony function
  ****************************************************************************/
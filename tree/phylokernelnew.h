@@ -1136,6 +1136,22 @@ inline void computeBounds(int threads, int packets, size_t elements, vector<size
             outError("Too many threads may slow down analysis [-nt option]. Reduce threads or use -nt AUTO to automatically determine it");
     }
 }
+
+/**
+    write the constant partial likelihood of a subtree that is unknown for a whole block of patterns
+    @param unknown_lh inv_evec times the all-ones vector for each category (block entries)
+    @param dad_partial_lh partial_lh of the block
+    @param dad_scale_num scale_num of the block
+ */
+template <class VectorClass, const bool SAFE_NUMERIC>
+inline void setUnknownBlock(double *unknown_lh, size_t block, size_t ncat_mix,
+    double *dad_partial_lh, UBYTE *dad_scale_num)
+{
+    VectorClass *partial_lh = (VectorClass*)dad_partial_lh;
+    for (size_t i = 0; i < block; i++)
+        partial_lh[i] = unknown_lh[i];
+    memset(dad_scale_num, 0, sizeof(UBYTE) * VectorClass::size() * (SAFE_NUMERIC ? ncat_mix : 1));
+}
 #endif
 
 #ifdef KERNEL_FIX_STATES
@@ -1202,6 +1218,27 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
     if (traversal_info.empty())
         return;
 
+    // track pattern blocks where whole subtrees are unknown, only valid if the tip
+    // likelihood of the unknown state is all ones (see computePartialLikelihoodSIMD)
+    bool track_unknown = model->useRevKernel() && !model->isSiteSpecificModel();
+    if (track_unknown) {
+        double tip_lh_unknown[model->num_states];
+        model->computeTipLikelihood(aln->STATE_UNKNOWN, tip_lh_unknown);
+        for (int i = 0; i < model->num_states; i++)
+            if (tip_lh_unknown[i] != 1.0)
+                track_unknown = false;
+    }
+    size_t num_blocks = roundUpToMultiple(roundUpToMultiple(aln->size(), VectorClass::size())
+        + model_factory->unobserved_ptns.size(), VectorClass::size()) / VectorClass::size();
+    for (auto it = traversal_info.begin(); it != traversal_info.end(); it++) {
+        PhyloNeighbor *nei = it->dad_branch;
+        if (track_unknown) {
+            nei->unknown_blocks.resize(num_blocks);
+            nei->unknown_blocks_lh = nei->partial_lh;
+        } else
+            nei->unknown_blocks_lh = NULL;
+    }
+
     if (!model->isSiteSpecificModel()) {
 
         int num_info = traversal_info.size();
@@ -1401,6 +1438,27 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         len_right = etmp;
 	}
 
+    // sparse supermatrices: if a subtree is unknown for a whole block of patterns, its real partial
+    // likelihood is 1 for all states. The block then holds the constant inv_evec*1 vector and
+    // the products with that subtree are skipped in the parent
+    UBYTE *dad_unknown = SITE_MODEL ? NULL : dad_branch->getUnknownBlocks();
+    UBYTE *left_unknown = NULL, *right_unknown = NULL;
+    double unknown_lh[block];
+    if (dad_unknown) {
+        left_unknown = left->getUnknownBlocks();
+        right_unknown = right->getUnknownBlocks();
+        for (size_t c = 0; c < ncat_mix; c++)
+            for (size_t i = 0; i < nstates; i++) {
+                double *inv_evec_row = inv_evec + mix_addr[c] + i*nstates;
+                double lh_unknown = 0.0;
+                for (size_t x = 0; x < nstates; x++)
+                    lh_unknown += inv_evec_row[x];
+                unknown_lh[c*nstates+i] = lh_unknown;
+            }
+        memset(dad_unknown + ptn_lower/VectorClass::size(), 0,
+            sizeof(UBYTE) * (ptn_upper-ptn_lower)/VectorClass::size());
+    }
+
     if (node->degree() > 3) {
         /*--------------------- multifurcating node ------------------*/
 
@@ -1681,6 +1739,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
             } else {
                 VectorClass *vleft  = (VectorClass*)vec_left;
                 VectorClass *vright = (VectorClass*)vec_right;
+                bool all_unknown = (dad_unknown != NULL);
                 // load data for tip
                 for (size_t x = 0; x < VectorClass::size(); x++) {
                     int leftState;
@@ -1706,6 +1765,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                         leftState  = unknown;
                         rightState = unknown;
                     }
+                    all_unknown &= (leftState == unknown && rightState == unknown);
                     double* tip_left  = partial_lh_left  + block*leftState;
                     double* tip_right = partial_lh_right + block*rightState;
                     double* this_vec_left = vec_left+x;
@@ -1718,6 +1778,13 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     }
                 }
 
+                if (all_unknown) {
+                    // scale_num was already zeroed
+                    setUnknownBlock<VectorClass, SAFE_NUMERIC>(unknown_lh, block, ncat_mix, (double*)partial_lh,
+                        dad_branch->scale_num + (SAFE_NUMERIC ? ptn*ncat_mix : ptn));
+                    dad_unknown[ptn/VectorClass::size()] = 1;
+                    continue;
+                }
 
                 for (size_t c = 0; c < ncat_mix; c++) {
                     double *inv_evec_ptr = inv_evec + mix_addr[c];
@@ -1814,6 +1881,8 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
 
             } else {
                 VectorClass *vleft = (VectorClass*)vec_left;
+                bool right_all_unknown = right_unknown && right_unknown[ptn/VectorClass::size()];
+                bool all_unknown = right_all_unknown;
                 // load data for tip
                 for (size_t x = 0; x < VectorClass::size(); x++) {
                     int state;
@@ -1830,6 +1899,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     } else {
                         state = unknown;
                     }
+                    all_unknown &= (state == unknown);
                     double *tip = partial_lh_left + block*state;
                     double *this_vec_left = vec_left+x;
                     for (size_t i = 0; i < block; i++) {
@@ -1838,6 +1908,13 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     }
                 }
 
+                if (all_unknown) {
+                    setUnknownBlock<VectorClass, SAFE_NUMERIC>(unknown_lh, block, ncat_mix, (double*)partial_lh,
+                        dad_branch->scale_num + (SAFE_NUMERIC ? ptn*ncat_mix : ptn));
+                    dad_unknown[ptn/VectorClass::size()] = 1;
+                    continue;
+                }
+
                 double *eright_ptr = eright;
                 for (size_t c = 0; c < ncat_mix; c++) {
                     if (SAFE_NUMERIC)
@@ -1845,14 +1922,19 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     double *inv_evec_ptr = inv_evec + mix_addr[c];
                     // compute real partial likelihood vector
                     for (size_t x = 0; x < nstates; x++) {
-                        VectorClass vright;
+                        if (right_all_unknown) {
+                            // real partial likelihood of the right subtree is 1
+                            partial_lh_tmp[x] = vleft[x];
+                        } else {
+                            VectorClass vright;
     #ifdef KERNEL_FIX_STATES
-                        dotProductVec<VectorClass, double, nstates, FMA>(eright_ptr, partial_lh_right, vright);
+                            dotProductVec<VectorClass, double, nstates, FMA>(eright_ptr, partial_lh_right, vright);
     #else
-                        dotProductVec<VectorClass, double, FMA>(eright_ptr, partial_lh_right, vright, nstates);
+                            dotProductVec<VectorClass, double, FMA>(eright_ptr, partial_lh_right, vright, nstates);
     #endif
+                            partial_lh_tmp[x] = vleft[x] * (vright);
+                        }
                         eright_ptr += nstates;
-                        partial_lh_tmp[x] = vleft[x] * (vright);
                     }
 
                     // compute dot-product with inv_eigenvector
@@ -1913,6 +1995,15 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
 			VectorClass *partial_lh_right = (VectorClass*)(right->partial_lh + ptn*block);
             VectorClass lh_max = 0.0;
             UBYTE *scale_dad, *scale_left, *scale_right;
+            bool left_all_unknown = left_unknown && left_unknown[ptn/VectorClass::size()];
+            bool right_all_unknown = right_unknown && right_unknown[ptn/VectorClass::size()];
+
+            if (left_all_unknown && right_all_unknown) {
+                setUnknownBlock<VectorClass, SAFE_NUMERIC>(unknown_lh, block, ncat_mix, (double*)partial_lh,
+                    dad_branch->scale_num + (SAFE_NUMERIC ? ptn*ncat_mix : ptn));
+                dad_unknown[ptn/VectorClass::size()] = 1;
+                continue;
+            }
 
             if (SAFE_NUMERIC) {
                 size_t addr = ptn*ncat_mix;
@@ -1970,11 +2061,26 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     double *inv_evec_ptr = inv_evec + mix_addr[c];
                     // compute real partial likelihood vector
                     for (size_t x = 0; x < nstates; x++) {
+                        // skip the product with a subtree whose real partial likelihood is 1
+                        if (left_all_unknown) {
+#ifdef KERNEL_FIX_STATES
+                            dotProductVec<VectorClass, double, nstates, FMA>(eright_ptr, partial_lh_right, partial_lh_tmp[x]);
+#else
+                            dotProductVec<VectorClass, double, FMA>(eright_ptr, partial_lh_right, partial_lh_tmp[x], nstates);
+#endif
+                        } else if (right_all_unknown) {
 #ifdef KERNEL_FIX_STATES
-                        dotProductDualVec<VectorClass, double, nstates, FMA>(eleft_ptr, partial_lh_left, eright_ptr, partial_lh_right, partial_lh_tmp[x]);
+                            dotProductVec<VectorClass, double, nstates, FMA>(eleft_ptr, partial_lh_left, partial_lh_tmp[x]);
 #else
-                        dotProductDualVec<VectorClass, double, FMA>(eleft_ptr, partial_lh_left, eright_ptr, partial_lh_right, partial_lh_tmp[x], nstates);
+                            dotProductVec<VectorClass, double, FMA>(eleft_ptr, partial_lh_left, partial_lh_tmp[x], nstates);
 #endif
+                        } else {
+#ifdef KERNEL_FIX_STATES
+                            dotProductDualVec<VectorClass, double, nstates, FMA>(eleft_ptr, partial_lh_left, eright_ptr, partial_lh_right, partial_lh_tmp[x]);
+#else
+                            dotProductDualVec<VectorClass, double, FMA>(eleft_ptr, partial_lh_left, eright_ptr, partial_lh_right, partial_lh_tmp[x], nstates);
+#endif
+                        }
                         eleft_ptr += nstates;
                         eright_ptr += nstates;
                     }
@@ -52,6 +52,7 @@ public:
         partial_pars = NULL;
         direction = UNDEFINED_DIRECTION;
         size = 0;
+        unknown_blocks_lh = NULL;
     }
 
     /**
@@ -68,6 +69,7 @@ public:
         partial_pars = NULL;
         direction = UNDEFINED_DIRECTION;
         size = 0;
+        unknown_blocks_lh = NULL;
     }
 
     /**
@@ -82,6 +84,7 @@ public:
         partial_pars = NULL;
         direction = nei->direction;
         size = nei->size;
+        unknown_blocks_lh = NULL;
     }
 
     
@@ -98,6 +101,7 @@ public:
      */
     inline void clearPartialLh() {
         partial_lh_computed = 0;
+        unknown_blocks_lh = NULL;
     }
 
     /**
@@ -147,6 +151,14 @@ public:
         return size;
     }
 
+    /**
+        @return flags of pattern blocks where the subtree is all unknown,
+        NULL if they are not maintained for the current partial_lh
+     */
+    UBYTE *getUnknownBlocks() {
+        return (partial_lh && unknown_blocks_lh == partial_lh) ? unknown_blocks.data() : NULL;
+    }
+
 private:
 
     /**
@@ -182,6 +194,18 @@ private:
     /** size of subtree below this neighbor in terms of number of taxa */
     int size;
 
+    /**
+        one flag per SIMD block of patterns: 1 if all taxa of the subtree are unknown (gaps)
+        for all patterns of the block, in which case the block of partial_lh holds the
+        constant all-unknown vector and zero scaling
+     */
+    vector<UBYTE> unknown_blocks;
+
+    /**
+        partial_lh vector that unknown_blocks refers to, NULL if the flags are not maintained
+     */
+    double *unknown_blocks_lh;
+
 };
 
 /**
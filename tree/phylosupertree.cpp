@@ -215,6 +215,9 @@ void PhyloSuperTree::changeLikelihoodKernel(LikelihoodKernel lk) {
 
 void PhyloSuperTree::setNumThreads(int num_threads) {
     PhyloTree::setNumThreads((size() >= num_threads) ? num_threads : 1);
+    // batch sizes depend on the number of threads
+    part_batches.clear();
+    part_batches_by_nptn.clear();
     for (iterator it = begin(); it != end(); it++)
         (*it)->setNumThreads((size() >= num_threads) ? 1 : num_threads);
 }
@@ -641,9 +644,21 @@ int PhyloSuperTree::computeParsimonyBranchObsolete(PhyloNeighbor *dad_branch, Ph
 }
 
 void PhyloSuperTree::computePartitionOrder() {
-    if (!part_order.empty())
+    if (!part_order.empty() && !part_batches.empty())
         return;
     int i, ntrees = size();
+    DoubleVector part_cost(ntrees), part_cost_by_nptn(ntrees);
+    for (i = 0; i < ntrees; i++) {
+        Alignment *part_aln = at(i)->aln;
+        part_cost[i] = ((double)part_aln->getNSeq())*part_aln->getNPattern()*part_aln->num_states;
+        part_cost_by_nptn[i] = ((double)part_aln->getNPattern())*part_aln->num_states;
+    }
+    if (!part_order.empty()) {
+        // only the batches were reset, e.g. by setNumThreads
+        computePartitionBatches(part_order, part_cost, part_batches);
+        computePartitionBatches(part_order_by_nptn, part_cost_by_nptn, part_batches_by_nptn);
+        return;
+    }
     part_order.resize(ntrees);
     part_order_by_nptn.resize(ntrees);
 #ifdef _OPENMP
@@ -651,8 +666,7 @@ void PhyloSuperTree::computePartitionOrder() {
     double *cost = new double[ntrees];
     
     for (i = 0; i < ntrees; i++) {
-        Alignment *part_aln = at(i)->aln;
-        cost[i] = -((double)part_aln->getNSeq())*part_aln->getNPattern()*part_aln->num_states;
+        cost[i] = -part_cost[i];
         id[i] = i;
     }
     quicksort(cost, 0, ntrees-1, id);
@@ -661,8 +675,7 @@ void PhyloSuperTree::computePartitionOrder() {
         
     // compute part_order by number of patterns
     for (i = 0; i < ntrees; i++) {
-        Alignment *part_aln = at(i)->aln;
-        cost[i] = -((double)part_aln->getNPattern())*part_aln->num_states;
+        cost[i] = -part_cost_by_nptn[i];
         id[i] = i;
     }
     quicksort(cost, 0, ntrees-1, id);
@@ -685,6 +698,70 @@ void PhyloSuperTree::computePartitionOrder() {
         part_order_by_nptn[i] = i;
     }
 #endif // OPENMP
+    computePartitionBatches(part_order, part_cost, part_batches);
+    computePartitionBatches(part_order_by_nptn, part_cost_by_nptn, part_batches_by_nptn);
+    if (verbose_mode >= VB_MED && part_batches.size() < ntrees)
+        cout << ntrees << " partitions grouped into " << part_batches.size() << " batches" << endl;
+}
+
+void PhyloSuperTree::computePartitionBatches(IntVector &order, DoubleVector &cost, vector<IntVector> &batches) {
+    int i, ntrees = order.size();
+    batches.clear();
+    if (ntrees == 0)
+        return;
+    double total_cost = 0.0;
+    for (i = 0; i < ntrees; i++)
+        total_cost += cost[i];
+    // a few batches per thread keep dynamic scheduling effective
+    int nbatches = max(num_threads, 1) * 8;
+    if (nbatches >= ntrees) {
+        for (i = 0; i < ntrees; i++)
+            batches.push_back(IntVector(1, order[i]));
+        return;
+    }
+    double max_cost = total_cost / nbatches;
+
+    // pack partitions with the same likelihood vector layout together
+    // (number of states and categories), large partitions form their own batch
+    map<pair<int,int>, int> open_batch;
+    DoubleVector batch_cost;
+    for (i = 0; i < ntrees; i++) {
+        int part = order[i];
+        PhyloTree *part_tree = at(part);
+        int ncat = 1;
+        if (part_tree->getModelFactory() && part_tree->getRate() && part_tree->getModel()) {
+            ncat = part_tree->getRate()->getNDiscreteRate();
+            if (part_tree->getModel()->isMixture())
+                ncat *= part_tree->getModel()->getNMixtures();
+        }
+        pair<int,int> layout(part_tree->aln->num_states, ncat);
+        auto it = open_batch.find(layout);
+        if (cost[part] >= max_cost || it == open_batch.end() || batch_cost[it->second] + cost[part] > max_cost) {
+            batches.push_back(IntVector(1, part));
+            batch_cost.push_back(cost[part]);
+            if (cost[part] < max_cost)
+                open_batch[layout] = batches.size()-1;
+        } else {
+            batches[it->second].push_back(part);
+            batch_cost[it->second] += cost[part];
+        }
+    }
+
+    // largest batches first, as for part_order
+    int nbatch = batches.size();
+    int *id = new int[nbatch];
+    double *sort_cost = new double[nbatch];
+    for (i = 0; i < nbatch; i++) {
+        sort_cost[i] = -batch_cost[i];
+        id[i] = i;
+    }
+    quicksort(sort_cost, 0, nbatch-1, id);
+    vector<IntVector> sorted_batches(nbatch);
+    for (i = 0; i < nbatch; i++)
+        sorted_batches[i].swap(batches[id[i]]);
+    batches.swap(sorted_batches);
+    delete [] sort_cost;
+    delete [] id;
 }
 
 double PhyloSuperTree::computeLikelihood(double *pattern_lh) {
@@ -700,14 +777,16 @@ double PhyloSuperTree::computeLikelihood(double *pattern_lh) {
 			pattern_lh += at(i)->getAlnNPattern();
 		}
 	} else {
-        if (part_order.empty()) computePartitionOrder();
+        if (part_batches.empty()) computePartitionOrder();
+        int nbatches = part_batches.size();
 		#ifdef _OPENMP
 		#pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
 		#endif
-		for (int j = 0; j < ntrees; j++) {
-            int i = part_order[j];
-			part_info[i].cur_score = at(i)->computeLikelihood();
-			tree_lh += part_info[i].cur_score;
+		for (int j = 0; j < nbatches; j++) {
+            for (int i : part_batches[j]) {
+                part_info[i].cur_score = at(i)->computeLikelihood();
+                tree_lh += part_info[i].cur_score;
+            }
 		}
 	}
 	return tree_lh;
@@ -761,16 +840,18 @@ void PhyloSuperTree::computePatternProbabilityCategory(double *ptn_prob_cat, Sit
 double PhyloSuperTree::optimizeAllBranches(int my_iterations, double tolerance, int maxNRStep) {
 	double tree_lh = 0.0;
 	int ntrees = size();
-    if (part_order.empty()) computePartitionOrder();
+    if (part_batches.empty()) computePartitionOrder();
+    int nbatches = part_batches.size();
 	#ifdef _OPENMP
 	#pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
 	#endif
-	for (int j = 0; j < ntrees; j++) {
-        int i = part_order[j];
-		part_info[i].cur_score = at(i)->optimizeAllBranches(my_iterations, tolerance/min(ntrees,10), maxNRStep);
-		tree_lh += part_info[i].cur_score;
-		if (verbose_mode >= VB_MAX)
-			at(i)->printTree(cout, WT_BR_LEN + WT_NEWLINE);
+	for (int j = 0; j < nbatches; j++) {
+        for (int i : part_batches[j]) {
+            part_info[i].cur_score = at(i)->optimizeAllBranches(my_iterations, tolerance/min(ntrees,10), maxNRStep);
+            tree_lh += part_info[i].cur_score;
+            if (verbose_mode >= VB_MAX)
+                at(i)->printTree(cout, WT_BR_LEN + WT_NEWLINE);
+        }
 	}
 
 	if (my_iterations >= 100) computeBranchLengths();
@@ -1379,18 +1460,14 @@ void PhyloSuperTree::computeMarginalAncestralState(PhyloNeighbor *dad_branch, Ph
 void PhyloSuperTree::writeMarginalAncestralState(ostream &out, PhyloNode *node,
     double *ptn_ancestral_prob, int *ptn_ancestral_seq) {
     int part = 1;
+    StrVector ptn_str;
     for (auto it = begin(); it != end(); ++it, ++part) {
         size_t nsites  = (*it)->getAlnNSite();
         int    nstates = (*it)->model->num_states;
+        (*it)->formatMarginalAncestralState(out, ptn_ancestral_prob, ptn_ancestral_seq, ptn_str);
         for (size_t site = 0; site < nsites; ++site) {
             int ptn = (*it)->aln->getPatternID(site);
-            out << node->name << "\t" << part << "\t" << site+1 << "\t";
-            out << (*it)->aln->convertStateBackStr(ptn_ancestral_seq[ptn]);
-            double *state_prob = ptn_ancestral_prob + ptn*nstates;
-            for (int j = 0; j < nstates; ++j) {
-                out << "\t" << state_prob[j];
-            }
-            out << endl;
+            out << node->name << "\t" << part << "\t" << site+1 << "\t" << ptn_str[ptn] << "\n";
         }
         size_t nptn = (*it)->getAlnNPattern();
         ptn_ancestral_prob += nptn*nstates;
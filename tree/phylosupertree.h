@@ -360,6 +360,24 @@ public:
     /* compute part_order vector */
     void computePartitionOrder();
 
+    /**
+        partition IDs grouped into batches for the parallel loops over partitions,
+        sorted in descending order of total computation cost
+    */
+    vector<IntVector> part_batches;
+    vector<IntVector> part_batches_by_nptn;
+
+    /**
+        group partitions into batches of similar computation cost. Small partitions with
+        the same number of states and rate categories are packed into one batch, such that
+        a thread processes them back-to-back with warm buffers. This reduces scheduling
+        overhead and load imbalance with thousands of small partitions.
+        @param order partition IDs in descending order of cost
+        @param cost computation cost of each partition, indexed by partition ID
+        @param[out] batches resulting batches
+    */
+    void computePartitionBatches(IntVector &order, DoubleVector &cost, vector<IntVector> &batches);
+
     /**
             get the name of the model
     */
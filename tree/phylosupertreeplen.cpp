@@ -265,15 +265,17 @@ void PhyloSuperTreePlen::optimizeOneBranch(PhyloNode *node1, PhyloNode *node2, b
 	//this->clearAllPartialLH();
 	PhyloTree::optimizeOneBranch(node1, node2, false, maxNRStep);
 
-    if (part_order.empty()) computePartitionOrder();
+    if (part_batches_by_nptn.empty()) computePartitionOrder();
+    int nbatches = part_batches_by_nptn.size();
 	// bug fix: assign cur_score into part_info
     #ifdef _OPENMP
-    #pragma omp parallel for private(part) schedule(dynamic) if(num_threads > 1)
+    #pragma omp parallel for schedule(dynamic) if(num_threads > 1)
     #endif    
-    for (int partid = 0; partid < size(); partid++) {
-        part = part_order_by_nptn[partid];
-        if (((SuperNeighbor*)current_it)->link_neighbors[part]) {
-            part_info[part].cur_score = at(part)->computeLikelihoodFromBuffer();
+    for (int batch = 0; batch < nbatches; batch++) {
+        for (int part : part_batches_by_nptn[batch]) {
+            if (((SuperNeighbor*)current_it)->link_neighbors[part]) {
+                part_info[part].cur_score = at(part)->computeLikelihoodFromBuffer();
+            }
         }
     }
 
@@ -294,7 +296,6 @@ void PhyloSuperTreePlen::optimizeOneBranch(PhyloNode *node1, PhyloNode *node2, b
 double PhyloSuperTreePlen::computeFunction(double value) {
 
 	double tree_lh = 0.0;
-	int ntrees = size();
 
 	if (!central_partial_lh) initializeAllPartialLh();
 
@@ -306,12 +307,13 @@ double PhyloSuperTreePlen::computeFunction(double value) {
 	SuperNeighbor *nei2 = (SuperNeighbor*)current_it->node->findNeighbor(current_it_back->node);
 	ASSERT(nei1 && nei2);
 
-    if (part_order.empty()) computePartitionOrder();
+    if (part_batches_by_nptn.empty()) computePartitionOrder();
+    int nbatches = part_batches_by_nptn.size();
     #ifdef _OPENMP
     #pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
     #endif    
-	for (int partid = 0; partid < ntrees; partid++) {
-            int part = part_order_by_nptn[partid];
+	for (int batch = 0; batch < nbatches; batch++)
+        for (int part : part_batches_by_nptn[batch]) {
 			PhyloNeighbor *nei1_part = nei1->link_neighbors[part];
 			PhyloNeighbor *nei2_part = nei2->link_neighbors[part];
 			if (nei1_part && nei2_part) {
@@ -352,7 +354,6 @@ void PhyloSuperTreePlen::computeFuncDerv(double value, double &df_ret, double &d
 	double df = 0.0;
 	double ddf = 0.0;
 
-	int ntrees = size();
 
 	if (!central_partial_lh) initializeAllPartialLh();
 
@@ -364,12 +365,13 @@ void PhyloSuperTreePlen::computeFuncDerv(double value, double &df_ret, double &d
 	SuperNeighbor *nei2 = (SuperNeighbor*)current_it->node->findNeighbor(current_it_back->node);
 	ASSERT(nei1 && nei2);
 
-    if (part_order.empty()) computePartitionOrder();
+    if (part_batches_by_nptn.empty()) computePartitionOrder();
+    int nbatches = part_batches_by_nptn.size();
     #ifdef _OPENMP
     #pragma omp parallel for reduction(+: df, ddf) schedule(dynamic) if(num_threads > 1)
     #endif    
-	for (int partid = 0; partid < ntrees; partid++) {
-        int part = part_order_by_nptn[partid];
+	for (int batch = 0; batch < nbatches; batch++)
+    for (int part : part_batches_by_nptn[batch]) {
         double df_aux, ddf_aux;
         PhyloNeighbor *nei1_part = nei1->link_neighbors[part];
         PhyloNeighbor *nei2_part = nei2->link_neighbors[part];
@@ -89,6 +89,7 @@ void PhyloTree::init() {
     nni_scale_num = NULL;
     central_partial_pars = NULL;
     cost_matrix = NULL;
+    computeParsimonyInsertPointer = NULL;
     model_factory = NULL;
     discard_saturated_site = true;
     _pattern_lh = NULL;
@@ -1366,6 +1367,65 @@ double PhyloTree::computePatternLhCat(SiteLoglType wsl) {
     return score;
 }
 
+double PhyloTree::computePatternPosteriorCat(size_t ncat, double *cat_factor, double *cat_sum, bool transform) {
+    // patterns are processed in fixed blocks, so that the sums do not depend on the number of threads
+    const size_t PTN_BLOCK = 256;
+    size_t nptn = aln->getNPattern();
+    size_t nblock = (nptn + PTN_BLOCK - 1) / PTN_BLOCK;
+    double *block_sum = aligned_alloc<double>(nblock*(ncat+1));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads) if(nblock > 1 && num_threads > 1)
+#endif
+    for (size_t block = 0; block < nblock; block++) {
+        double *this_sum = block_sum + block*(ncat+1);
+        memset(this_sum, 0, (ncat+1)*sizeof(double));
+        size_t ptn_end = min(nptn, (block+1)*PTN_BLOCK);
+        for (size_t ptn = block*PTN_BLOCK; ptn < ptn_end; ptn++) {
+            double *this_lk_cat = _pattern_lh_cat + ptn*ncat;
+            double lk_ptn = ptn_invar[ptn];
+            if (cat_factor) {
+                for (size_t c = 0; c < ncat; c++)
+                    lk_ptn += this_lk_cat[c] * cat_factor[c];
+            } else {
+                for (size_t c = 0; c < ncat; c++)
+                    lk_ptn += this_lk_cat[c];
+            }
+            ASSERT(lk_ptn != 0.0);
+            this_sum[ncat] += ptn_freq[ptn] * log(lk_ptn);
+            lk_ptn = ptn_freq[ptn] / lk_ptn;
+            if (transform) {
+                // transform _pattern_lh_cat into posterior probabilities of each category
+                if (cat_factor) {
+                    for (size_t c = 0; c < ncat; c++)
+                        this_lk_cat[c] *= cat_factor[c];
+                }
+                for (size_t c = 0; c < ncat; c++) {
+                    this_lk_cat[c] *= lk_ptn;
+                    this_sum[c] += this_lk_cat[c];
+                }
+            } else if (cat_factor) {
+                for (size_t c = 0; c < ncat; c++)
+                    this_sum[c] += this_lk_cat[c] * cat_factor[c] * lk_ptn;
+            } else {
+                for (size_t c = 0; c < ncat; c++)
+                    this_sum[c] += this_lk_cat[c] * lk_ptn;
+            }
+        }
+    }
+
+    double logl = 0.0;
+    memset(cat_sum, 0, ncat*sizeof(double));
+    for (size_t block = 0; block < nblock; block++) {
+        double *this_sum = block_sum + block*(ncat+1);
+        for (size_t c = 0; c < ncat; c++)
+            cat_sum[c] += this_sum[c];
+        logl += this_sum[ncat];
+    }
+    aligned_free(block_sum);
+    return logl;
+}
+
 void PhyloTree::computePatternStateFreq(double *ptn_state_freq) {
     ASSERT(getModel()->isMixture());
     computePatternLhCat(WSL_MIXTURE);
@@ -2840,10 +2900,58 @@ double PhyloTree::optimizeRootPosition(int root_dist, bool write_info, double lo
     return curScore;
 }
 
+void PhyloTree::evaluateRootPositions(IntVector &node1_ids, IntVector &node2_ids, IntVector &roots, int first, int last,
+    bool full_opt, const string &start_tree, double logl_epsilon, DoubleVector &scores, StrVector &trees, string &first_root_tree)
+{
+    for (int i = first; i < last; i++) {
+        int r = roots[i];
+        if (!full_opt && i > first) {
+            readTreeString(start_tree);
+            initializeAllPartialLh();
+        }
+        Node *node1 = findNodeID(node1_ids[r]);
+        Node *node2 = findNodeID(node2_ids[r]);
+        ASSERT(node1 && node2);
+        // the two nodes are not adjacent if the root is already on their branch
+        if (node1->isNeighbor(node2))
+            moveRoot(node1, node2);
+        clearAllPartialLH();
+        if (full_opt) {
+            setCurScore(optimizeAllBranches(100, logl_epsilon));
+        } else {
+            // only adjust the branches close to the new root and the branch joining the old root
+            NodeVector nodes1, nodes2;
+            getBranches(2, nodes1, nodes2, root->neighbors[0]->node, root);
+            Node *old_node1 = findNodeID(node1_ids[0]);
+            Node *old_node2 = findNodeID(node2_ids[0]);
+            if (old_node1->isNeighbor(old_node2)) {
+                nodes1.push_back(old_node1);
+                nodes2.push_back(old_node2);
+            }
+            for (int j = 0; j < nodes1.size(); j++)
+                optimizeOneBranch((PhyloNode*)nodes1[j], (PhyloNode*)nodes2[j]);
+            setCurScore(computeLikelihood());
+        }
+        scores[r] = curScore;
+        stringstream ss;
+        printTree(ss);
+        trees[r] = ss.str();
+        if (r == 0)
+            first_root_tree = getTreeString();
+    }
+}
+
 double PhyloTree::testRootPosition(bool write_info, double logl_epsilon, IntVector &branch_ids, string out_file) {
     if (!rooted)
         return curScore;
     
+    double orig_score = curScore;
+
+    // node IDs are the same in all copies of the tree read from this string
+    string cur_tree = getTreeString();
+    readTreeString(cur_tree);
+    initializeAllPartialLh();
+
     BranchVector branches;
     getBranches(branches);
     int i;
@@ -2856,55 +2964,132 @@ double PhyloTree::testRootPosition(bool write_info, double logl_epsilon, IntVect
         else
             root_br.second = (*it)->node;
     }
-    
-    double best_score = curScore, orig_score = curScore;
-    
-    multimap<double, pair<int,string> > logl_trees;
-    
-    // ignore branches directly descended from root branch
-    for (i = 0; i != branches.size(); )
-        if (branches[i].first == root_nei || branches[i].second == root_nei) {
-            branches[i] = branches[branches.size()-1];
-            branches.pop_back();
-        } else {
-            i++;
-        }
-    branches.push_back(root_br);
-    string cur_tree = getTreeString();
-        
-    // get all trees
-    StrVector trees;
+
+    // the current root goes first, such that it starts from the current branch lengths.
+    // Other roots follow in pre-order, such that consecutive roots are mostly neighbours
+    IntVector node1_ids, node2_ids;
     branch_ids.clear();
+    node1_ids.push_back(root_br.first->id);
+    node2_ids.push_back(root_br.second->id);
+    // the branch joining the two root children takes the ID of the first of them
+    branch_ids.push_back(root_br.first->findNeighbor(root_nei)->id);
+    // ignore branches directly descended from root branch
     for (i = 0; i != branches.size(); i++) {
+        if (branches[i].first == root_nei || branches[i].second == root_nei)
+            continue;
+        node1_ids.push_back(branches[i].first->id);
+        node2_ids.push_back(branches[i].second->id);
         branch_ids.push_back(branches[i].first->findNeighbor(branches[i].second)->id);
-        moveRoot(branches[i].first, branches[i].second);
-        if (branches[i] == root_br)
-            trees.push_back(cur_tree);
-        else
-            trees.push_back(getTreeString());
     }
+    int num_roots = branch_ids.size();
+    IntVector roots;
+    for (i = 0; i < num_roots; i++)
+        roots.push_back(i);
 
-    // optimize branch lengths for all trees
-    for (i = 0; i != trees.size(); i++) {
-        readTreeString(trees[i]);
-        setCurScore(optimizeAllBranches(100, logl_epsilon));
-        stringstream ss;
-        printTree(ss);
-        logl_trees.insert({curScore, make_pair(branch_ids[i], ss.str())});
+    // copies of the tree sharing alignment and model, each evaluating a block of roots
+    vector<PhyloTree*> copies;
+    copies.push_back(this);
+    int orig_threads = num_threads;
+    int threads_per_copy = num_threads;
+#ifdef _OPENMP
+    if (num_threads > 1 && !isSuperTree() && !isMixlen() && !params->pll && !params->store_trans_matrix) {
+        int num_copies = min(num_threads, num_roots);
+        uint64_t mem_required = getMemoryRequired();
+        uint64_t total_mem = getMemorySize();
+        if (mem_required > 0 && num_copies * mem_required > total_mem * 0.95)
+            num_copies = max(1, (int)(total_mem * 0.95 / mem_required));
+        threads_per_copy = max(1, num_threads / num_copies);
+        for (i = 1; i < num_copies; i++) {
+            PhyloTree *copy = new PhyloTree(aln);
+            copy->setParams(params);
+            copy->rooted = rooted;
+            copy->optimize_by_newton = optimize_by_newton;
+            copy->sse = sse;
+            copy->setNumThreads(threads_per_copy);
+            copy->setModelFactory(getModelFactory());
+            copy->readTreeString(cur_tree);
+            copy->initializeAllPartialLh();
+            copies.push_back(copy);
+        }
+        if (copies.size() > 1) {
+            setNumThreads(threads_per_copy);
+            cout << "Testing " << num_roots << " root positions with " << copies.size() << " tree copies, "
+                 << threads_per_copy << " threads per copy" << endl;
+        }
+    }
+#endif
+    int num_copies = copies.size();
+
+    DoubleVector scores(num_roots, -DBL_MAX);
+    StrVector trees(num_roots);
+    string first_root_tree;
+    bool first_pass = params->root_test_top > 0 && params->root_test_top < num_roots;
+    for (int full_opt = 0; full_opt < 2; full_opt++) {
+        if (!full_opt && !first_pass)
+            continue;
+        if (full_opt && first_pass) {
+            // start again from the current branch lengths
+            for (i = 0; i < num_copies; i++) {
+                copies[i]->readTreeString(cur_tree);
+                copies[i]->initializeAllPartialLh();
+            }
+        }
+        int num_eval = roots.size();
+#ifdef _OPENMP
+        omp_set_nested(num_copies > 1 && threads_per_copy > 1);
+        #pragma omp parallel for schedule(static,1) num_threads(num_copies) if(num_copies > 1)
+#endif
+        for (int c = 0; c < num_copies; c++) {
+            copies[c]->evaluateRootPositions(node1_ids, node2_ids, roots,
+                (int)((int64_t)num_eval*c/num_copies), (int)((int64_t)num_eval*(c+1)/num_copies),
+                full_opt, cur_tree, logl_epsilon, scores, trees, first_root_tree);
+        }
+#ifdef _OPENMP
+        omp_set_nested(false);
+#endif
+        if (!full_opt) {
+            if (verbose_mode >= VB_MED) {
+                for (i = 0; i < num_roots; i++)
+                    cout << "Root pos " << i+1 << " first pass: " << scores[i] << endl;
+            }
+            // keep the current root and the best roots by the first pass, in the original order
+            IntVector order = roots;
+            sort(order.begin()+1, order.end(), [&](int a, int b) { return scores[a] > scores[b]; });
+            order.resize(params->root_test_top);
+            sort(order.begin(), order.end());
+            cout << "Optimizing branch lengths for the " << order.size() << " best of " << num_roots
+                 << " root positions" << endl;
+            roots = order;
+        }
+    }
+
+    for (i = 1; i < num_copies; i++) {
+        // model is owned by this tree
+        copies[i]->setModelFactory(NULL);
+        delete copies[i];
+    }
+    if (num_copies > 1)
+        setNumThreads(orig_threads);
+
+    double best_score = orig_score;
+    multimap<double, pair<int,string> > logl_trees;
+    for (i = 0; i != roots.size(); i++) {
+        int r = roots[i];
+        logl_trees.insert({scores[r], make_pair(branch_ids[r], trees[r])});
         if (verbose_mode >= VB_MED) {
-            cout << "Root pos " << i+1 << ": " << curScore << endl;
-            if (verbose_mode >= VB_DEBUG)
-                drawTree(cout);
+            cout << "Root pos " << r+1 << ": " << scores[r] << endl;
         }
-        if (curScore > best_score + logl_epsilon) {
+        if (scores[r] > best_score + logl_epsilon) {
             if (verbose_mode >= VB_MED || write_info)
-                cout << "Better root: " << curScore << endl;
-            best_score = curScore;
+                cout << "Better root: " << scores[r] << endl;
+            best_score = scores[r];
         }
     }
-    
-//    readTreeString(best_tree);
-//    curScore = computeLikelihood();
+
+    // continue with the current root
+    readTreeString(first_root_tree);
+    initializeAllPartialLh();
+    setCurScore(computeLikelihood());
     
     if (!(curScore > orig_score - 0.1))
         cout << "curScore: " << curScore << " orig_score: " << orig_score << endl;
@@ -2923,13 +3108,6 @@ double PhyloTree::testRootPosition(bool write_info, double logl_epsilon, IntVect
     out.close();
     cout << "Rooted trees with log-likelihoods printed to " << out_file << endl;
 
-    // convert logL to weight based on the best score
-//    ASSERT(logLs.size() == nodes1.size());
-//    for (i = 0; i < logLs.size(); i++) {
-//        double weight = exp(logLs[i] - best_score);
-//        nodes1[i]->name = convertDoubleToString(weight);
-//    }
-    
     return curScore;
 }
 
@@ -3319,6 +3497,10 @@ double PhyloTree::computeDist_Experimental(double *dist_mat, double *var_mat) {
             return longest_dist;
         }
     }
+    if (!aln->isSuperAlignment()) {
+        EX_TRACE("Computing distances of bit-sliced sequences");
+        return computeDist(dist_mat, var_mat);
+    }
     EX_TRACE("Summarizing...");
     AlignmentSummary s(aln, false, false);
     int maxDistance = 0;
@@ -3351,8 +3533,8 @@ double PhyloTree::computeDist_Experimental(double *dist_mat, double *var_mat) {
     double longest = computeDistanceMatrix
         ( params->ls_var_type, static_cast<char>(aln->STATE_UNKNOWN)
          , s.sequenceMatrix, s.sequenceCount, s.sequenceLength
-         , denominator, frequencies, aln->num_states
-         , uncorrected, dist_mat, var_mat);
+         , denominator, frequencies, uncorrected
+         , aln->num_states, dist_mat, var_mat);
     EX_TRACE("Longest distance was " << longest);
     return longest;
 }
@@ -3363,6 +3545,14 @@ double PhyloTree::computeDist(double *dist_mat, double *var_mat) {
     double longest_dist = 0.0;
     cout.precision(6);
     double baseTime = getRealTime();
+    // observed and Jukes-Cantor distances of all pairs at once, the latter also serve
+    // as initial values for ML distances. Partitioned alignments define their own distances
+    // (with -experimental, initial ML distances come from the converted sequences instead)
+    bool has_model = model_factory && site_rate;
+    bool obs_dist_matrix = !aln->isSuperAlignment() &&
+        (!has_model || (!params->experimental && !params->compute_obs_dist));
+    if (obs_dist_matrix)
+        aln->computeDistMatrix(dist_mat, !params->compute_obs_dist);
     progress_display progress(nseqs*(nseqs-1)/2, "Calculating distance matrix"); //zork
     //compute the upper-triangle of distance matrix
     #ifdef _OPENMP
@@ -3379,7 +3569,8 @@ double PhyloTree::computeDist(double *dist_mat, double *var_mat) {
         for (size_t seq2=seq1+1; seq2 < nseqs; ++seq2) {
             size_t sym_pos = rowStartPos + seq2;
             double d2l = var_mat[sym_pos]; // moved here for thread-safe (OpenMP)
-            dist_mat[sym_pos] = processor->recomputeDist(seq1, seq2, dist_mat[sym_pos], d2l);
+            if (!obs_dist_matrix || has_model)
+                dist_mat[sym_pos] = processor->recomputeDist(seq1, seq2, dist_mat[sym_pos], d2l);
             if (params->ls_var_type == OLS)
                 var_mat[sym_pos] = 1.0;
             else if (params->ls_var_type == WLS_PAUPLIN)
@@ -3703,7 +3894,7 @@ void PhyloTree::doOneRandomNNI(Branch branch) {
         nni.node1Nei_it = node1NeiIt;
         break;
     }
-    int randInt = random_int(branch.second->neighbors.size()-1);
+    int randInt = random_int(branch.second->neighbors.size()-1, rstream);
     int cnt = 0;
     FOR_NEIGHBOR_IT(branch.second, branch.first, node2NeiIt) {
         // if this loop, is it sure that direction is away from root because node1->node2 is away from root
@@ -3722,7 +3913,7 @@ void PhyloTree::doOneRandomNNI(Branch branch) {
 }
 */
     
-NNIMove PhyloTree::getRandomNNI(Branch &branch) {
+NNIMove PhyloTree::getRandomNNI(Branch &branch, int *rstream) {
     ASSERT(isInnerBranch(branch.first, branch.second));
     // for rooted tree
     if (((PhyloNeighbor*)branch.first->findNeighbor(branch.second))->direction == TOWARD_ROOT) {
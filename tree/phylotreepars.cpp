@@ -1174,6 +1174,20 @@ int PhyloTree::computeParsimonyTree(const char *out_prefix, Alignment *alignment
 
 int PhyloTree::addTaxonMPFast(Node *added_taxon, Node* added_node, Node* node, Node* dad) {
 
+    if (computeParsimonyInsertPointer) {
+        // score the insertion from the partial parsimony of the three subtrees, leaving the tree unchanged
+        PhyloNeighbor *taxon_branch = (PhyloNeighbor*)added_node->findNeighbor(added_taxon);
+        PhyloNeighbor *node_branch = (PhyloNeighbor*)dad->findNeighbor(node);
+        PhyloNeighbor *dad_branch = (PhyloNeighbor*)node->findNeighbor(dad);
+        if ((taxon_branch->partial_lh_computed & 2) == 0)
+            computePartialParsimony(taxon_branch, (PhyloNode*)added_node);
+        if ((node_branch->partial_lh_computed & 2) == 0)
+            computePartialParsimony(node_branch, (PhyloNode*)dad);
+        if ((dad_branch->partial_lh_computed & 2) == 0)
+            computePartialParsimony(dad_branch, (PhyloNode*)node);
+        return (this->*computeParsimonyInsertPointer)(taxon_branch, node_branch, dad_branch);
+    }
+
     // now insert the new node in the middle of the branch node-dad
     insertNode2Branch(added_node, node, dad);
 
@@ -58,6 +58,7 @@ void PhyloTree::setParsimonyKernel(LikelihoodKernel lk) {
         if (lk < LK_SSE2) {
             computeParsimonyBranchPointer = &PhyloTree::computeParsimonyBranchSankoff;
             computePartialParsimonyPointer = &PhyloTree::computePartialParsimonySankoff;
+            computeParsimonyInsertPointer = NULL;
             return;
         }
         if (lk >= LK_AVX) {
@@ -75,6 +76,7 @@ void PhyloTree::setParsimonyKernel(LikelihoodKernel lk) {
     if (lk < LK_SSE2) {
         computeParsimonyBranchPointer = &PhyloTree::computeParsimonyBranchFast;
         computePartialParsimonyPointer = &PhyloTree::computePartialParsimonyFast;
+        computeParsimonyInsertPointer = NULL;
     	return;
     }
     if (lk >= LK_AVX) {
@@ -1485,6 +1487,9 @@ void PhyloTree::computeMarginalAncestralState(PhyloNeighbor *dad_branch, PhyloNo
     }
 
     // now normalize to probability
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
     for (size_t ptn = 0; ptn < nptn; ptn++) {
         double *state_prob = ptn_ancestral_prob + ptn*nstates;
         double sum = 0.0;
@@ -1508,20 +1513,34 @@ void PhyloTree::computeMarginalAncestralState(PhyloNeighbor *dad_branch, PhyloNo
 
 }
 
-void PhyloTree::writeMarginalAncestralState(ostream &out, PhyloNode *node, double *ptn_ancestral_prob, int *ptn_ancestral_seq) {
-    size_t nsites = aln->getNSite();
+void PhyloTree::formatMarginalAncestralState(ostream &out, double *ptn_ancestral_prob, int *ptn_ancestral_seq, StrVector &ptn_str) {
+    size_t nptn = getAlnNPattern();
     size_t nstates = model->num_states;
-    for (size_t site = 0; site < nsites; ++site) {
-        int ptn = aln->getPatternID(site);
-        out << node->name << "\t" << site+1 << "\t";
-//        if (params->print_ancestral_sequence == AST_JOINT)
-//            out << aln->convertStateBackStr(joint_ancestral_node[ptn]) << "\t";
-        out << aln->convertStateBackStr(ptn_ancestral_seq[ptn]);
+    ptn_str.resize(nptn);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        ostringstream ss;
+        ss.flags(out.flags());
+        ss.precision(out.precision());
+        ss << aln->convertStateBackStr(ptn_ancestral_seq[ptn]);
         double *state_prob = ptn_ancestral_prob + ptn*nstates;
         for (size_t j = 0; j < nstates; j++) {
-            out << "\t" << state_prob[j];
+            ss << "\t" << state_prob[j];
         }
-        out << endl;
+        ptn_str[ptn] = ss.str();
+    }
+}
+
+void PhyloTree::writeMarginalAncestralState(ostream &out, PhyloNode *node, double *ptn_ancestral_prob, int *ptn_ancestral_seq) {
+    size_t nsites = aln->getNSite();
+    // columns only depend on the pattern, so format them once per pattern
+    StrVector ptn_str;
+    formatMarginalAncestralState(out, ptn_ancestral_prob, ptn_ancestral_seq, ptn_str);
+    for (size_t site = 0; site < nsites; ++site) {
+        int ptn = aln->getPatternID(site);
+        out << node->name << "\t" << site+1 << "\t" << ptn_str[ptn] << "\n";
     }
 
 }
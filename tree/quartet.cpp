@@ -25,6 +25,9 @@
 #include <omp.h>
 #endif
 
+#include <vectorclass/vectormath_exp.h>
+#include <vectorclass/vectorclass.h>
+
 #if 0  /*** moved to phylotree.h ***/
 /* Index definition for counter array needed in likelihood mapping analysis (HAS) */
 #define LM_REG1 0   /* top corner */
@@ -673,6 +676,443 @@ void finisheps(FILE *ofp, vector<SeqQuartetInfo> lmap_seq_quartet_info, int leaf
 //*** end of likelihood mapping stuff (imported from TREE-PUZZLE's lmap.c) (HAS)
 
 
+/**
+    Likelihood engine specialised for the three quartet topologies of likelihood mapping.
+    It works directly on the patterns of the full alignment compressed to the 4 sequences,
+    shares the eigen decomposition of the model and precomputes the transition-weighted
+    tip vectors of all states, so that no Alignment or PhyloTree is built per quartet.
+    Each thread owns one engine and reuses its buffers for all of its quartets.
+*/
+class QuartetLikelihoodEngine : public Optimization {
+public:
+
+    /**
+        constructor
+        @param tree tree providing alignment, model and rate heterogeneity
+    */
+    QuartetLikelihoodEngine(PhyloTree *tree);
+
+    /**
+        @return true if the model of tree can be handled by this engine
+        (single alignment, reversible non-mixture model without site-specific parts or ASC)
+    */
+    static bool isSupported(PhyloTree *tree);
+
+    /**
+        compute log-likelihoods of the 3 quartet topologies with optimized branch lengths
+        @param seq_id IDs of the 4 sequences
+        @param[out] logl log-likelihoods of {0,1}|{2,3}, {0,2}|{1,3} and {0,3}|{1,2}
+    */
+    void computeQuartetLikelihoods(int *seq_id, double *logl);
+
+    /**
+        negative log-likelihood derivatives w.r.t. the length of the current branch
+    */
+    virtual void computeFuncDerv(double value, double &df, double &ddf);
+
+protected:
+
+    /**
+        compress the alignment patterns of the 4 sequences into quartet patterns
+        @param seq_id IDs of the 4 sequences
+    */
+    void initQuartetPatterns(int *seq_id);
+
+    /**
+        compute P(t)*tip vector of all states for one tip of the current topology
+        @param tip tip position in the topology (0..3)
+    */
+    void computeTipVectors(int tip);
+
+    /**
+        compute the per-pattern eigen coefficients of the current branch
+        @param branch 0..3 for the tip branches, 4 for the internal branch
+    */
+    void computeTheta(int branch);
+
+    /**
+        optimize all 5 branch lengths of the current topology
+        @param max_steps maximum number of rounds over all branches
+        @param tolerance log-likelihood improvement to stop
+        @return log-likelihood
+    */
+    double optimizeBranches(int max_steps, double tolerance);
+
+    Params *params;
+
+    int nstates;
+
+    /** number of rate categories */
+    int ncat;
+
+    /** number of state values in the alignment (incl. ambiguous and unknown) */
+    int nvalues;
+
+    double *eval, *evec, *inv_evec;
+
+    DoubleVector state_freq;
+
+    DoubleVector rates, props;
+
+    double p_invar;
+
+    /** inverse eigenvectors times tip likelihood vector for each state value */
+    DoubleVector tip_eigen;
+
+    /** tip likelihood vector for each state value */
+    DoubleVector tip_lh;
+
+    Alignment *aln;
+
+    /** map from the 4 states of a site to the quartet pattern ID */
+    unordered_map<uint64_t, int> qptn_map;
+
+    /** states of the quartet patterns, 4 per pattern */
+    vector<StateType> qptn_states;
+
+    DoubleVector qptn_freq;
+
+    /** likelihood of the quartet patterns under invariant sites */
+    DoubleVector qptn_invar;
+
+    /** position of the topology tips among the 4 sequences */
+    int tip_order[4];
+
+    /** branch lengths: 4 tip branches then the internal branch */
+    double brlen[5];
+
+    /** P(t)*tip vector for each tip, category and state value */
+    DoubleVector tip_vec[4];
+
+    /**
+        eigen coefficients of the current branch, stored pattern-contiguous for each
+        category and eigenvalue so that computeFuncDerv() runs SIMD over patterns
+    */
+    DoubleVector theta;
+
+    /** per cherry state pair: offset into pair_vec, -1 if not yet computed */
+    IntVector pair_index[2];
+
+    /** vectors of computeTheta() that only depend on the states of one cherry (and the sibling tip) */
+    DoubleVector pair_vec[2];
+
+    /** per cherry state pair and sibling state: offset into pair_vec[1], -1 if not yet computed */
+    IntVector sib_index;
+
+    /** optimized tip branch lengths of the last topology, indexed by the 4 sequences */
+    double seq_brlen[4];
+
+    /** log-likelihood of the last computeFuncDerv() call */
+    double cur_logl;
+
+    int cur_branch;
+};
+
+QuartetLikelihoodEngine::QuartetLikelihoodEngine(PhyloTree *tree) {
+    params = tree->params;
+    aln = tree->aln;
+    ModelSubst *model = tree->getModel();
+    RateHeterogeneity *site_rate = tree->getRate();
+    nstates = model->num_states;
+    ncat = site_rate->getNRate();
+    nvalues = aln->STATE_UNKNOWN+1;
+    eval = model->getEigenvalues();
+    evec = model->getEigenvectors();
+    inv_evec = model->getInverseEigenvectors();
+    state_freq.resize(nstates);
+    model->getStateFrequency(&state_freq[0]);
+    rates.resize(ncat);
+    props.resize(ncat);
+    for (int c = 0; c < ncat; c++) {
+        rates[c] = site_rate->getRate(c);
+        props[c] = site_rate->getProp(c);
+    }
+    p_invar = site_rate->getPInvar();
+
+    tip_lh.resize(nvalues*nstates);
+    tip_eigen.resize(nvalues*nstates);
+    for (int z = 0; z < nvalues; z++) {
+        double *lh = &tip_lh[z*nstates];
+        model->computeTipLikelihood(z, lh);
+        for (int i = 0; i < nstates; i++) {
+            double val = 0.0;
+            for (int j = 0; j < nstates; j++)
+                val += inv_evec[i*nstates+j] * lh[j];
+            tip_eigen[z*nstates+i] = val;
+        }
+    }
+    for (int k = 0; k < 4; k++)
+        tip_vec[k].resize(ncat*nvalues*nstates);
+    cur_logl = 0.0;
+    cur_branch = 0;
+}
+
+bool QuartetLikelihoodEngine::isSupported(PhyloTree *tree) {
+    ModelSubst *model = tree->getModel();
+    return !tree->isSuperTree() && !tree->aln->isSuperAlignment() &&
+        tree->aln->seq_type != SEQ_POMO && tree->aln->num_states == model->num_states &&
+        model->isReversible() && model->getNMixtures() == 1 && !model->isSiteSpecificModel() &&
+        !tree->getRate()->isHeterotachy() && tree->getRate()->getPtnCat(0) < 0 &&
+        tree->getModelFactory()->ASC_type == ASC_NONE;
+}
+
+void QuartetLikelihoodEngine::initQuartetPatterns(int *seq_id) {
+    qptn_map.clear();
+    qptn_states.clear();
+    qptn_freq.clear();
+    size_t nptn = aln->getNPattern();
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        Pattern &pat = aln->at(ptn);
+        uint64_t key = 0;
+        for (int k = 0; k < 4; k++)
+            key = (key << 16) | pat[seq_id[k]];
+        auto it = qptn_map.find(key);
+        if (it == qptn_map.end()) {
+            qptn_map[key] = qptn_freq.size();
+            for (int k = 0; k < 4; k++)
+                qptn_states.push_back(pat[seq_id[k]]);
+            qptn_freq.push_back(pat.frequency);
+        } else
+            qptn_freq[it->second] += pat.frequency;
+    }
+    size_t nqptn = qptn_freq.size();
+    qptn_invar.resize(nqptn);
+    for (size_t ptn = 0; ptn < nqptn; ptn++) {
+        double invar = 0.0;
+        if (p_invar > 0.0) {
+            StateType *states = &qptn_states[ptn*4];
+            for (int s = 0; s < nstates; s++)
+                invar += state_freq[s] * tip_lh[states[0]*nstates+s] * tip_lh[states[1]*nstates+s] *
+                    tip_lh[states[2]*nstates+s] * tip_lh[states[3]*nstates+s];
+            invar *= p_invar;
+        }
+        qptn_invar[ptn] = invar;
+    }
+    theta.resize(nqptn*ncat*nstates);
+}
+
+void QuartetLikelihoodEngine::computeTipVectors(int tip) {
+    double expt[nstates];
+    double *vec = &tip_vec[tip][0];
+    for (int c = 0; c < ncat; c++) {
+        for (int i = 0; i < nstates; i++)
+            expt[i] = exp(eval[i]*rates[c]*brlen[tip]);
+        for (int z = 0; z < nvalues; z++, vec += nstates) {
+            double *this_tip_eigen = &tip_eigen[z*nstates];
+            for (int s = 0; s < nstates; s++) {
+                double val = 0.0;
+                for (int i = 0; i < nstates; i++)
+                    val += evec[s*nstates+i] * expt[i] * this_tip_eigen[i];
+                vec[s] = val;
+            }
+        }
+    }
+}
+
+void QuartetLikelihoodEngine::computeTheta(int branch) {
+    size_t nqptn = qptn_freq.size();
+    size_t block = nvalues*nstates;
+    size_t catstates = ncat*nstates;
+    double expint[catstates];
+    for (int c = 0; c < ncat; c++)
+        for (int i = 0; i < nstates; i++)
+            expint[c*nstates+i] = exp(eval[i]*rates[c]*brlen[4]);
+
+    // vectors that only depend on the states of a cherry (and of the sibling tip)
+    // are computed once per distinct combination
+    for (int k = 0; k < 2; k++) {
+        pair_index[k].assign(nvalues*nvalues, -1);
+        pair_vec[k].clear();
+    }
+    sib_index.clear();
+
+    // for a tip branch: sibling tip and the 2 tips on the other side of the internal branch
+    int sib = branch ^ 1;
+    int other = (branch < 2) ? 2 : 0;
+
+    for (size_t ptn = 0; ptn < nqptn; ptn++) {
+        StateType *states = &qptn_states[ptn*4];
+        if (branch == 4) {
+            // internal branch: both sides are cherries, theta = A(tips 0,1) * B(tips 2,3)
+            double *vec[2];
+            for (int k = 0; k < 2; k++) {
+                StateType s1 = states[tip_order[2*k]], s2 = states[tip_order[2*k+1]];
+                int &idx = pair_index[k][s1*nvalues+s2];
+                if (idx < 0) {
+                    idx = pair_vec[k].size();
+                    pair_vec[k].resize(idx + catstates);
+                    double *this_vec = &pair_vec[k][idx];
+                    for (int c = 0; c < ncat; c++, this_vec += nstates) {
+                        double *h1 = &tip_vec[2*k][c*block + s1*nstates];
+                        double *h2 = &tip_vec[2*k+1][c*block + s2*nstates];
+                        for (int i = 0; i < nstates; i++) {
+                            double val = 0.0;
+                            if (k == 0) {
+                                for (int s = 0; s < nstates; s++)
+                                    val += state_freq[s] * h1[s] * h2[s] * evec[s*nstates+i];
+                            } else {
+                                for (int s = 0; s < nstates; s++)
+                                    val += inv_evec[i*nstates+s] * h1[s] * h2[s];
+                            }
+                            this_vec[i] = val;
+                        }
+                    }
+                }
+                vec[k] = &pair_vec[k][idx];
+            }
+            for (size_t i = 0; i < catstates; i++)
+                theta[i*nqptn + ptn] = vec[0][i] * vec[1][i];
+            continue;
+        }
+
+        // move the other cherry along the internal branch, back into state space
+        StateType s1 = states[tip_order[other]], s2 = states[tip_order[other+1]];
+        int &idx = pair_index[0][s1*nvalues+s2];
+        if (idx < 0) {
+            idx = pair_vec[0].size();
+            pair_vec[0].resize(idx + catstates);
+            sib_index.resize(sib_index.size() + nvalues, -1);
+            double *this_vec = &pair_vec[0][idx];
+            for (int c = 0; c < ncat; c++, this_vec += nstates) {
+                double *ho1 = &tip_vec[other][c*block + s1*nstates];
+                double *ho2 = &tip_vec[other+1][c*block + s2*nstates];
+                double coeff[nstates];
+                for (int i = 0; i < nstates; i++) {
+                    double b = 0.0;
+                    for (int s = 0; s < nstates; s++)
+                        b += inv_evec[i*nstates+s] * ho1[s] * ho2[s];
+                    coeff[i] = b * expint[c*nstates+i];
+                }
+                for (int s = 0; s < nstates; s++) {
+                    double g = 0.0;
+                    for (int i = 0; i < nstates; i++)
+                        g += evec[s*nstates+i] * coeff[i];
+                    this_vec[s] = g;
+                }
+            }
+        }
+
+        // combine with the sibling tip and move to eigen space
+        StateType sib_state = states[tip_order[sib]];
+        int &sidx = sib_index[(idx/catstates)*nvalues + sib_state];
+        if (sidx < 0) {
+            sidx = pair_vec[1].size();
+            pair_vec[1].resize(sidx + catstates);
+            double *other_vec = &pair_vec[0][idx];
+            double *this_vec = &pair_vec[1][sidx];
+            for (int c = 0; c < ncat; c++, other_vec += nstates, this_vec += nstates) {
+                double *hsib = &tip_vec[sib][c*block + sib_state*nstates];
+                for (int i = 0; i < nstates; i++) {
+                    double a = 0.0;
+                    for (int s = 0; s < nstates; s++)
+                        a += state_freq[s] * hsib[s] * other_vec[s] * evec[s*nstates+i];
+                    this_vec[i] = a;
+                }
+            }
+        }
+        double *sib_vec = &pair_vec[1][sidx];
+        double *this_tip_eigen = &tip_eigen[states[tip_order[branch]]*nstates];
+        for (int c = 0; c < ncat; c++)
+            for (int i = 0; i < nstates; i++)
+                theta[(c*nstates+i)*nqptn + ptn] = sib_vec[c*nstates+i] * this_tip_eigen[i];
+    }
+}
+
+void QuartetLikelihoodEngine::computeFuncDerv(double value, double &df, double &ddf) {
+    size_t nqptn = qptn_freq.size();
+    size_t catstates = ncat*nstates;
+    double val0[catstates], val1[catstates], val2[catstates];
+    for (int c = 0; c < ncat; c++)
+        for (int i = 0; i < nstates; i++) {
+            double rate = eval[i]*rates[c];
+            val0[c*nstates+i] = exp(rate*value) * props[c];
+            val1[c*nstates+i] = val0[c*nstates+i] * rate;
+            val2[c*nstates+i] = val1[c*nstates+i] * rate;
+        }
+
+    // SIMD over blocks of patterns, theta is pattern-contiguous
+    size_t nblock = nqptn - (nqptn % Vec2d::size());
+    Vec2d logl_vec = 0.0, df_vec = 0.0, ddf_vec = 0.0;
+    for (size_t ptn = 0; ptn < nblock; ptn += Vec2d::size()) {
+        Vec2d lh, d1 = 0.0, d2 = 0.0, this_theta, freq;
+        lh.load(&qptn_invar[ptn]);
+        for (size_t i = 0; i < catstates; i++) {
+            this_theta.load(&theta[i*nqptn + ptn]);
+            lh = mul_add(this_theta, val0[i], lh);
+            d1 = mul_add(this_theta, val1[i], d1);
+            d2 = mul_add(this_theta, val2[i], d2);
+        }
+        lh = max(lh, Vec2d(DBL_MIN));
+        freq.load(&qptn_freq[ptn]);
+        d1 /= lh;
+        logl_vec = mul_add(log(lh), freq, logl_vec);
+        df_vec = mul_add(d1, freq, df_vec);
+        ddf_vec = mul_add(d2/lh - d1*d1, freq, ddf_vec);
+    }
+    double logl = horizontal_add(logl_vec), my_df = horizontal_add(df_vec), my_ddf = horizontal_add(ddf_vec);
+    for (size_t ptn = nblock; ptn < nqptn; ptn++) {
+        double lh = qptn_invar[ptn], d1 = 0.0, d2 = 0.0;
+        for (size_t i = 0; i < catstates; i++) {
+            double this_theta = theta[i*nqptn + ptn];
+            lh += this_theta * val0[i];
+            d1 += this_theta * val1[i];
+            d2 += this_theta * val2[i];
+        }
+        lh = max(lh, DBL_MIN);
+        d1 /= lh;
+        logl += qptn_freq[ptn] * log(lh);
+        my_df += qptn_freq[ptn] * d1;
+        my_ddf += qptn_freq[ptn] * (d2/lh - d1*d1);
+    }
+    cur_logl = logl;
+    df = -my_df;
+    ddf = -my_ddf;
+}
+
+double QuartetLikelihoodEngine::optimizeBranches(int max_steps, double tolerance) {
+    // tip branches start from their lengths in the previous topology
+    for (int k = 0; k < 4; k++)
+        brlen[k] = seq_brlen[tip_order[k]];
+    brlen[4] = 0.1;
+    for (int k = 0; k < 4; k++)
+        computeTipVectors(k);
+
+    double logl = -DBL_MAX, df, ddf;
+    for (int step = 0; step < max_steps; step++) {
+        for (cur_branch = 0; cur_branch < 5; cur_branch++) {
+            computeTheta(cur_branch);
+            double negative_lh;
+            brlen[cur_branch] = minimizeNewton(params->min_branch_length, brlen[cur_branch],
+                params->max_branch_length, params->min_branch_length, negative_lh);
+            if (cur_branch < 4)
+                computeTipVectors(cur_branch);
+        }
+        // theta of the internal branch is up-to-date with all other branches
+        computeFuncDerv(brlen[4], df, ddf);
+        if (cur_logl <= logl + tolerance) {
+            logl = max(logl, cur_logl);
+            break;
+        }
+        logl = cur_logl;
+    }
+    for (int k = 0; k < 4; k++)
+        seq_brlen[tip_order[k]] = brlen[k];
+    return logl;
+}
+
+void QuartetLikelihoodEngine::computeQuartetLikelihoods(int *seq_id, double *logl) {
+    int qc[] = {0, 1, 2, 3,  0, 2, 1, 3,  0, 3, 1, 2};
+    initQuartetPatterns(seq_id);
+    for (int k = 0; k < 4; k++)
+        seq_brlen[k] = 0.1;
+    for (int k = 0; k < 3; k++) {
+        for (int i = 0; i < 4; i++)
+            tip_order[i] = qc[k*4+i];
+        // optimize branch lengths with logl_epsilon=0.1 accuracy
+        logl[k] = optimizeBranches(10, 0.1);
+    }
+}
+
 void PhyloTree::computeQuartetLikelihoods(vector<QuartetInfo> &lmap_quartet_info, QuartetGroups &LMGroups) {
 
     if (leafNum < 4) 
@@ -829,6 +1269,11 @@ void PhyloTree::computeQuartetLikelihoods(vector<QuartetInfo> &lmap_quartet_info
     // fprintf(stderr,"XXX - #quarts: %d; #groups: %d, A: %d, B:%d, C:%d, D:%d\n", LMGroups.uniqueQuarts, LMGroups.numGroups, sizeA, sizeB, sizeC, sizeD);
     
 
+    // quartets of a single alignment under a plain reversible model skip the per-quartet tree setup
+    bool use_quartet_engine = QuartetLikelihoodEngine::isSupported(this);
+    if (use_quartet_engine && verbose_mode >= VB_MED)
+        cout << "Using the specialised quartet likelihood engine" << endl;
+
 #ifdef _OPENMP
     #pragma omp parallel
     {
@@ -837,6 +1282,9 @@ void PhyloTree::computeQuartetLikelihoods(vector<QuartetInfo> &lmap_quartet_info
 #else
     int *rstream = randstream;
 #endif    
+    QuartetLikelihoodEngine *quartet_engine = NULL;
+    if (use_quartet_engine)
+        quartet_engine = new QuartetLikelihoodEngine(this);
 
 #ifdef _OPENMP
     #pragma omp for schedule(guided)
@@ -891,92 +1339,96 @@ void PhyloTree::computeQuartetLikelihoods(vector<QuartetInfo> &lmap_quartet_info
 	// *** taxa should not be sorted, because that changes the corners a dot is assigned to - removed HAS ;^)
         // obsolete: sort(lmap_quartet_info[qid].seqID, lmap_quartet_info[qid].seqID+4); // why sort them?!? HAS ;^)
 
-        // initialize sub-alignment and sub-tree
-        Alignment *quartet_aln;
-        if (aln->isSuperAlignment()) {
-            quartet_aln = new SuperAlignment;
+        if (quartet_engine) {
+            quartet_engine->computeQuartetLikelihoods(lmap_quartet_info[qid].seqID, lmap_quartet_info[qid].logl);
         } else {
-            quartet_aln = new Alignment;
-        }
-        IntVector seq_id;
-        seq_id.insert(seq_id.begin(), lmap_quartet_info[qid].seqID, lmap_quartet_info[qid].seqID+4);
-        IntVector kept_partitions;
-        // only keep partitions with at least 3 sequences
-        quartet_aln->extractSubAlignment(aln, seq_id, 0, 3, &kept_partitions);
-                
-        if (kept_partitions.size() == 0) {
-            // nothing kept
-            for (int k = 0; k < 3; k++) {
-                lmap_quartet_info[qid].logl[k] = -1.0;
-            }
-        } else {
-            // something partition kept, do computations
-            if (quartet_aln->ordered_pattern.empty())
-                quartet_aln->orderPatternByNumChars(PAT_VARIANT);
-            PhyloTree *quartet_tree;
-            if (isSuperTree()) {
-                quartet_tree = new PhyloSuperTree((SuperAlignment*)quartet_aln, (PhyloSuperTree*)this);
+            // initialize sub-alignment and sub-tree
+            Alignment *quartet_aln;
+            if (aln->isSuperAlignment()) {
+                quartet_aln = new SuperAlignment;
             } else {
-                quartet_tree = new PhyloTree(quartet_aln);
+                quartet_aln = new Alignment;
             }
-
-            // set up parameters
-            quartet_tree->setParams(params);
-            quartet_tree->optimize_by_newton = params->optimize_by_newton;
-            quartet_tree->setLikelihoodKernel(params->SSE);
-            quartet_tree->setNumThreads(num_threads);
-
-            // set model and rate
-            quartet_tree->setModelFactory(model_factory);
-            quartet_tree->setModel(getModel());
-            quartet_tree->setRate(getRate());
-
-            // set up partition model
-            if (isSuperTree()) {
-                PhyloSuperTree *quartet_super_tree = (PhyloSuperTree*)quartet_tree;
-                PhyloSuperTree *super_tree = (PhyloSuperTree*)this;
-                for (int i = 0; i < quartet_super_tree->size(); i++) {
-                    quartet_super_tree->at(i)->setModelFactory(super_tree->at(kept_partitions[i])->getModelFactory());
-                    quartet_super_tree->at(i)->setModel(super_tree->at(kept_partitions[i])->getModel());
-                    quartet_super_tree->at(i)->setRate(super_tree->at(kept_partitions[i])->getRate());
-                    //quartet_super_tree->at(i)->aln->buildSeqStates(quartet_super_tree->at(i)->getModel()->seq_states);
+            IntVector seq_id;
+            seq_id.insert(seq_id.begin(), lmap_quartet_info[qid].seqID, lmap_quartet_info[qid].seqID+4);
+            IntVector kept_partitions;
+            // only keep partitions with at least 3 sequences
+            quartet_aln->extractSubAlignment(aln, seq_id, 0, 3, &kept_partitions);
+                
+            if (kept_partitions.size() == 0) {
+                // nothing kept
+                for (int k = 0; k < 3; k++) {
+                    lmap_quartet_info[qid].logl[k] = -1.0;
                 }
             } else {
-                //quartet_aln->buildSeqStates(getModel()->seq_states);
-            }
+                // something partition kept, do computations
+                if (quartet_aln->ordered_pattern.empty())
+                    quartet_aln->orderPatternByNumChars(PAT_VARIANT);
+                PhyloTree *quartet_tree;
+                if (isSuperTree()) {
+                    quartet_tree = new PhyloSuperTree((SuperAlignment*)quartet_aln, (PhyloSuperTree*)this);
+                } else {
+                    quartet_tree = new PhyloTree(quartet_aln);
+                }
+
+                // set up parameters
+                quartet_tree->setParams(params);
+                quartet_tree->optimize_by_newton = params->optimize_by_newton;
+                quartet_tree->setLikelihoodKernel(params->SSE);
+                quartet_tree->setNumThreads(num_threads);
+
+                // set model and rate
+                quartet_tree->setModelFactory(model_factory);
+                quartet_tree->setModel(getModel());
+                quartet_tree->setRate(getRate());
+
+                // set up partition model
+                if (isSuperTree()) {
+                    PhyloSuperTree *quartet_super_tree = (PhyloSuperTree*)quartet_tree;
+                    PhyloSuperTree *super_tree = (PhyloSuperTree*)this;
+                    for (int i = 0; i < quartet_super_tree->size(); i++) {
+                        quartet_super_tree->at(i)->setModelFactory(super_tree->at(kept_partitions[i])->getModelFactory());
+                        quartet_super_tree->at(i)->setModel(super_tree->at(kept_partitions[i])->getModel());
+                        quartet_super_tree->at(i)->setRate(super_tree->at(kept_partitions[i])->getRate());
+                        //quartet_super_tree->at(i)->aln->buildSeqStates(quartet_super_tree->at(i)->getModel()->seq_states);
+                    }
+                } else {
+                    //quartet_aln->buildSeqStates(getModel()->seq_states);
+                }
             
-            // NOTE: we don't need to set phylo_tree in model and rate because parameters are not reoptimized
+                // NOTE: we don't need to set phylo_tree in model and rate because parameters are not reoptimized
             
             
             
-            // loop over 3 quartets to compute likelihood
-            for (int k = 0; k < 3; k++) {
-                string quartet_tree_str;
-                quartet_tree_str = "(" + quartet_aln->getSeqName(qc[k*4]) + "," + quartet_aln->getSeqName(qc[k*4+1]) + ",(" + 
-                    quartet_aln->getSeqName(qc[k*4+2]) + "," + quartet_aln->getSeqName(qc[k*4+3]) + "));";
-                quartet_tree->readTreeStringSeqName(quartet_tree_str);
-                quartet_tree->initializeAllPartialLh();
-                quartet_tree->wrapperFixNegativeBranch(true);
-                // optimize branch lengths with logl_epsilon=0.1 accuracy
-                lmap_quartet_info[qid].logl[k] = quartet_tree->optimizeAllBranches(10, 0.1);
-            }
-            // reset model & rate so that they are not deleted
-            quartet_tree->setModel(NULL);
-            quartet_tree->setModelFactory(NULL);
-            quartet_tree->setRate(NULL);
-
-            if (isSuperTree()) {
-                PhyloSuperTree *quartet_super_tree = (PhyloSuperTree*)quartet_tree;
-                for (int i = 0; i < quartet_super_tree->size(); i++) {
-                    quartet_super_tree->at(i)->setModelFactory(NULL);
-                    quartet_super_tree->at(i)->setModel(NULL);
-                    quartet_super_tree->at(i)->setRate(NULL);
+                // loop over 3 quartets to compute likelihood
+                for (int k = 0; k < 3; k++) {
+                    string quartet_tree_str;
+                    quartet_tree_str = "(" + quartet_aln->getSeqName(qc[k*4]) + "," + quartet_aln->getSeqName(qc[k*4+1]) + ",(" + 
+                        quartet_aln->getSeqName(qc[k*4+2]) + "," + quartet_aln->getSeqName(qc[k*4+3]) + "));";
+                    quartet_tree->readTreeStringSeqName(quartet_tree_str);
+                    quartet_tree->initializeAllPartialLh();
+                    quartet_tree->wrapperFixNegativeBranch(true);
+                    // optimize branch lengths with logl_epsilon=0.1 accuracy
+                    lmap_quartet_info[qid].logl[k] = quartet_tree->optimizeAllBranches(10, 0.1);
+                }
+                // reset model & rate so that they are not deleted
+                quartet_tree->setModel(NULL);
+                quartet_tree->setModelFactory(NULL);
+                quartet_tree->setRate(NULL);
+
+                if (isSuperTree()) {
+                    PhyloSuperTree *quartet_super_tree = (PhyloSuperTree*)quartet_tree;
+                    for (int i = 0; i < quartet_super_tree->size(); i++) {
+                        quartet_super_tree->at(i)->setModelFactory(NULL);
+                        quartet_super_tree->at(i)->setModel(NULL);
+                        quartet_super_tree->at(i)->setRate(NULL);
+                    }
                 }
+                delete quartet_tree;
             }
-            delete quartet_tree;
-        }
         
-        delete quartet_aln;
+            delete quartet_aln;
+        }
 
         // determine likelihood order
         int qworder[3]; // local (thread-safe) vector for sorting
@@ -1147,6 +1599,8 @@ void PhyloTree::computeQuartetLikelihoods(vector<QuartetInfo> &lmap_quartet_info
 		}
 	}
     } /*** end draw lmap_num_quartets quartets randomly ***/
+    if (quartet_engine)
+        delete quartet_engine;
 #ifdef _OPENMP
     finish_random(rstream);
     }
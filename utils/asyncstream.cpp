@@ -0,0 +1,241 @@
+//
+//  asyncstream.cpp
+//  utils
+//
+//  Background writer thread for AsyncOutputStream.
+//
+
+#include "asyncstream.h"
+#include "gzstream.h"
+#include <fstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/** size of the chunks handed over to the writer thread */
+static const size_t ASYNC_CHUNK_SIZE = 1 << 16;
+
+/** maximal number of bytes queued per file before the producer has to wait */
+static const size_t ASYNC_MAX_PENDING = 1 << 24;
+
+static bool async_output_enabled = true;
+
+void setAsyncOutput(bool enabled) {
+    async_output_enabled = enabled;
+}
+
+/**
+    the single writer thread shared by all AsyncOutputStream objects.
+    Jobs are processed in FIFO order, so the output of each file stays in order.
+*/
+class AsyncOutputWriter {
+public:
+    static AsyncOutputWriter &getInstance() {
+        static AsyncOutputWriter instance;
+        return instance;
+    }
+
+    /**
+        queue data for writing, waiting if too much output of this file is pending
+        @param buf the stream buffer
+        @param data data to write, moved into the queue
+        @param flush true to flush the file after writing
+        @param close true to close the file after writing
+    */
+    void submit(AsyncOutputBuf *buf, std::string &data, bool flush, bool close) {
+        if (!async_output_enabled) {
+            doWrite(buf, data, flush, close);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!worker.joinable())
+            worker = std::thread(&AsyncOutputWriter::run, this);
+        while (buf->pending_bytes > ASYNC_MAX_PENDING)
+            job_done.wait(lock);
+        buf->pending_bytes += data.size();
+        buf->pending_jobs++;
+        jobs.push_back(Job());
+        Job &job = jobs.back();
+        job.buf = buf;
+        job.data.swap(data);
+        job.flush = flush;
+        job.close = close;
+        job_ready.notify_one();
+    }
+
+    /** wait until all queued output of buf has been written */
+    void wait(AsyncOutputBuf *buf) {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (buf->pending_jobs > 0)
+            job_done.wait(lock);
+    }
+
+    ~AsyncOutputWriter() {
+        if (!worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        job_ready.notify_one();
+        worker.join();
+    }
+
+private:
+    struct Job {
+        AsyncOutputBuf *buf;
+        std::string data;
+        bool flush;
+        bool close;
+    };
+
+    AsyncOutputWriter() : stopping(false) {}
+
+    /** write one job to the file, called by the writer thread */
+    static void doWrite(AsyncOutputBuf *buf, std::string &data, bool flush, bool close) {
+        std::ostream *sink = buf->sink;
+        if (!data.empty())
+            sink->write(data.data(), data.size());
+        if (flush || close)
+            sink->flush();
+        if (close) {
+            if (std::ofstream *out = dynamic_cast<std::ofstream*>(sink))
+                out->close();
+            else if (ogzstream *out = dynamic_cast<ogzstream*>(sink))
+                out->close();
+        }
+        if (sink->fail())
+            buf->failed = true;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            while (jobs.empty() && !stopping)
+                job_ready.wait(lock);
+            if (jobs.empty())
+                break;
+            Job job;
+            job.data.swap(jobs.front().data);
+            job.buf = jobs.front().buf;
+            job.flush = jobs.front().flush;
+            job.close = jobs.front().close;
+            jobs.pop_front();
+            lock.unlock();
+            doWrite(job.buf, job.data, job.flush, job.close);
+            lock.lock();
+            job.buf->pending_bytes -= job.data.size();
+            job.buf->pending_jobs--;
+            job_done.notify_all();
+        }
+    }
+
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable job_ready, job_done;
+    std::deque<Job> jobs;
+    bool stopping;
+};
+
+// ----------------------------------------------------------------------------
+
+AsyncOutputBuf::AsyncOutputBuf() : sink(NULL), pending_bytes(0), pending_jobs(0), failed(false) {
+}
+
+AsyncOutputBuf::~AsyncOutputBuf() {
+    close();
+}
+
+AsyncOutputBuf *AsyncOutputBuf::open(const char *name, std::ios_base::openmode open_mode, bool compress) {
+    if (sink)
+        return NULL;
+    failed = false;
+    if (compress) {
+        ogzstream *out = new ogzstream();
+        out->open(name, open_mode);
+        sink = out;
+    } else {
+        std::ofstream *out = new std::ofstream();
+        out->open(name, open_mode);
+        sink = out;
+    }
+    if (sink->fail()) {
+        delete sink;
+        sink = NULL;
+        return NULL;
+    }
+    chunk.resize(ASYNC_CHUNK_SIZE);
+    setp(&chunk[0], &chunk[0] + chunk.size());
+    return this;
+}
+
+AsyncOutputBuf *AsyncOutputBuf::close() {
+    if (!sink)
+        return NULL;
+    std::string data(pbase(), pptr() - pbase());
+    setp(NULL, NULL);
+    AsyncOutputWriter::getInstance().submit(this, data, true, true);
+    AsyncOutputWriter::getInstance().wait(this);
+    delete sink;
+    sink = NULL;
+    return failed ? NULL : this;
+}
+
+bool AsyncOutputBuf::submitChunk(bool flush) {
+    if (!sink)
+        return false;
+    size_t size = pptr() - pbase();
+    if (size >= ASYNC_CHUNK_SIZE/2) {
+        // hand over the full chunk and start a new one
+        chunk.resize(size);
+        AsyncOutputWriter::getInstance().submit(this, chunk, flush, false);
+        chunk.resize(ASYNC_CHUNK_SIZE);
+    } else if (size > 0 || flush) {
+        std::string data(pbase(), size);
+        AsyncOutputWriter::getInstance().submit(this, data, flush, false);
+    }
+    setp(&chunk[0], &chunk[0] + chunk.size());
+    return !failed;
+}
+
+int AsyncOutputBuf::overflow(int c) {
+    if (!submitChunk(false))
+        return EOF;
+    if (c != EOF) {
+        *pptr() = c;
+        pbump(1);
+    }
+    return (c == EOF) ? 0 : c;
+}
+
+int AsyncOutputBuf::sync() {
+    return submitChunk(true) ? 0 : -1;
+}
+
+// ----------------------------------------------------------------------------
+
+AsyncOutputStream::AsyncOutputStream() : std::ostream(&buf) {
+}
+
+AsyncOutputStream::AsyncOutputStream(const char *name, std::ios_base::openmode open_mode, bool compress)
+    : std::ostream(&buf)
+{
+    open(name, open_mode, compress);
+}
+
+AsyncOutputStream::~AsyncOutputStream() {
+    buf.close();
+}
+
+void AsyncOutputStream::open(const char *name, std::ios_base::openmode open_mode, bool compress) {
+    if (!buf.open(name, open_mode, compress))
+        setstate(std::ios::failbit);
+    else
+        clear();
+}
+
+void AsyncOutputStream::close() {
+    if (!buf.close())
+        setstate(std::ios::failbit);
+}
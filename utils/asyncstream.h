@@ -0,0 +1,107 @@
+//
+//  asyncstream.h
+//  utils
+//
+//  Output streams whose file I/O (and optional gzip compression) is done
+//  by a dedicated background writer thread, such that compute threads only
+//  format text into memory.
+//
+
+#ifndef asyncstream_h
+#define asyncstream_h
+
+#include <iostream>
+#include <string>
+
+class AsyncOutputStream;
+
+/**
+    stream buffer collecting output in chunks, which are handed over to the
+    background writer thread when full or when the stream is flushed
+*/
+class AsyncOutputBuf : public std::streambuf {
+    friend class AsyncOutputStream;
+    friend class AsyncOutputWriter;
+public:
+    AsyncOutputBuf();
+    ~AsyncOutputBuf();
+
+    /**
+        open the underlying file
+        @param name file name
+        @param open_mode std::ios open mode
+        @param compress true to write a gzip-compressed file
+        @return this if successful, NULL otherwise
+    */
+    AsyncOutputBuf *open(const char *name, std::ios_base::openmode open_mode, bool compress);
+
+    /**
+        write pending output and close the file, waiting until it is complete
+        @return this if all output was written successfully, NULL otherwise
+    */
+    AsyncOutputBuf *close();
+
+    bool is_open() { return sink != NULL; }
+
+protected:
+    virtual int overflow(int c);
+    virtual int sync();
+
+private:
+    /** hand over the current chunk to the writer thread */
+    bool submitChunk(bool flush);
+
+    /** chunk being filled by the producer */
+    std::string chunk;
+
+    /** the file stream, only accessed by the writer thread while the file is open */
+    std::ostream *sink;
+
+    /** number of bytes queued but not yet written, guarded by the writer mutex */
+    size_t pending_bytes;
+
+    /** number of queued jobs, guarded by the writer mutex */
+    int pending_jobs;
+
+    /** true if the writer thread failed to write to the file */
+    bool failed;
+};
+
+/**
+    drop-in replacement for ofstream/ogzstream: writes are buffered in memory
+    and written to the file by the background writer thread. close() returns
+    only after the file is complete, so the file can be read back afterwards.
+    Errors while writing are reported when flushing or closing the stream.
+*/
+class AsyncOutputStream : public std::ostream {
+public:
+    AsyncOutputStream();
+
+    /**
+        @param name file name
+        @param open_mode std::ios open mode
+        @param compress true to write a gzip-compressed file
+    */
+    AsyncOutputStream(const char *name, std::ios_base::openmode open_mode = std::ios::out, bool compress = false);
+
+    ~AsyncOutputStream();
+
+    void open(const char *name, std::ios_base::openmode open_mode = std::ios::out, bool compress = false);
+
+    void close();
+
+    bool is_open() { return buf.is_open(); }
+
+    AsyncOutputBuf *rdbuf() { return &buf; }
+
+private:
+    AsyncOutputBuf buf;
+};
+
+/**
+    enable or disable background writing, e.g. for debugging.
+    If disabled, AsyncOutputStream writes synchronously in the calling thread.
+*/
+void setAsyncOutput(bool enabled);
+
+#endif /* asyncstream_h */
@@ -1031,6 +1031,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.root_move_dist = 2;
     params.root_find = false;
     params.root_test = false;
+    params.root_test_top = 0;
     params.sample_size = -1;
     params.repeated_time = 1;
     //params.nr_output = 10000;
@@ -1215,6 +1216,8 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.print_trees_site_posterior = 0;
     params.print_ancestral_sequence = AST_NONE;
     params.min_ancestral_prob = 0.0;
+    params.print_ancestral_binary = false;
+    params.ancestral_bin_file = NULL;
     params.print_tree_lh = false;
     params.lambda = 1;
     params.speed_conf = 1.0;
@@ -1273,6 +1276,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.testNNI = false;
     params.approximate_nni = false;
     params.do_compression = false;
+    params.async_output = true;
 
     params.new_heuristic = true;
     params.iteration_multiple = 1;
@@ -1293,6 +1297,8 @@ void parseArg(int argc, char *argv[], Params &params) {
 //    params.autostop = true; // turn on auto stopping rule by default now
     params.unsuccess_iteration = 100;
     params.speednni = true; // turn on reduced hill-climbing NNI by default now
+    params.local_nni_brlen = true;
+    params.num_walkers = 1;
     params.numInitTrees = 100;
     params.fixStableSplits = false;
     params.stableSplitThreshold = 0.9;
@@ -1598,6 +1604,17 @@ void parseArg(int argc, char *argv[], Params &params) {
                 params.root_test = true;
                 continue;
             }
+
+            if (strcmp(argv[cnt], "--root-test-top") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use --root-test-top <number_of_roots>";
+                params.root_test_top = convert_int(argv[cnt]);
+                if (params.root_test_top < 0)
+                    throw "--root-test-top must not be negative";
+                params.root_test = true;
+                continue;
+            }
             
 			if (strcmp(argv[cnt], "-all") == 0) {
 				params.find_all = true;
@@ -3772,6 +3789,21 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
 
+			if (strcmp(argv[cnt], "-asr-bin") == 0 || strcmp(argv[cnt], "--asr-bin") == 0) {
+				params.print_ancestral_sequence = AST_MARGINAL;
+				params.print_ancestral_binary = true;
+                params.ignore_identical_seqs = false;
+				continue;
+			}
+
+			if (strcmp(argv[cnt], "-asr-bin2txt") == 0 || strcmp(argv[cnt], "--asr-bin2txt") == 0) {
+                cnt++;
+				if (cnt >= argc)
+					throw "Use --asr-bin2txt <statebin_file>";
+                params.ancestral_bin_file = argv[cnt];
+                continue;
+            }
+
 			if (strcmp(argv[cnt], "-asr-joint") == 0) {
 				params.print_ancestral_sequence = AST_JOINT;
                 params.ignore_identical_seqs = false;
@@ -4180,6 +4212,10 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.do_compression = true;
 				continue;
 			}
+			if (strcmp(argv[cnt], "--no-async-out") == 0) {
+				params.async_output = false;
+				continue;
+			}
 			if (strcmp(argv[cnt], "-newheu") == 0) {
 				params.new_heuristic = true;
 				// Enable RAxML kernel
@@ -4377,6 +4413,23 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.speednni = false;
 				continue;
 			}
+			if (strcmp(argv[cnt], "--all-nni-brlen") == 0) {
+				params.local_nni_brlen = false;
+				continue;
+			}
+			if (strcmp(argv[cnt], "--walkers") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use --walkers <num_walkers|AUTO>";
+				if (iEquals(argv[cnt], "AUTO"))
+					params.num_walkers = 0;
+				else {
+					params.num_walkers = convert_int(argv[cnt]);
+					if (params.num_walkers < 1)
+						throw "At least 1 walker please";
+				}
+				continue;
+			}
             
 			if (strcmp(argv[cnt], "-snni") == 0) {
 				params.snni = true;
@@ -5276,7 +5329,7 @@ void parseArg(int argc, char *argv[], Params &params) {
         }
 
     } // for
-    if (!params.user_file && !params.aln_file && !params.ngs_file && !params.ngs_mapped_reads && !params.partition_file && !params.alisim_active) {
+    if (!params.user_file && !params.aln_file && !params.ngs_file && !params.ngs_mapped_reads && !params.partition_file && !params.alisim_active && !params.ancestral_bin_file) {
 #ifdef IQ_TREE
         quickStartGuide();
 //        usage_iqtree(argv, false);
@@ -5359,6 +5412,8 @@ void parseArg(int argc, char *argv[], Params &params) {
             params.out_prefix = params.ngs_file;
         else if (params.ngs_mapped_reads)
             params.out_prefix = params.ngs_mapped_reads;
+        else if (params.ancestral_bin_file)
+            params.out_prefix = params.ancestral_bin_file;
         else
             params.out_prefix = params.user_file;
     }
@@ -5558,6 +5613,7 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  -T NUM|AUTO          No. cores/threads or AUTO-detect (default: 1)" << endl
     << "  --threads-max NUM    Max number of threads for -T AUTO (default: all cores)" << endl
 #endif
+    << "  --no-async-out       Write output files in the compute thread (no writer thread)" << endl
     << endl << "CHECKPOINT:" << endl
     << "  --redo               Redo both ModelFinder and tree search" << endl
     << "  --redo-tree          Restore ModelFinder and only redo tree search" << endl
@@ -5585,6 +5641,8 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --perturb NUM        Perturbation strength for randomized NNI (default: 0.5)" << endl
     << "  --radius NUM         Radius for parsimony SPR search (default: 6)" << endl
     << "  --allnni             Perform more thorough NNI search (default: OFF)" << endl
+    << "  --all-nni-brlen      Optimize all branch lengths after each NNI step (default: OFF)" << endl
+    << "  --walkers NUM|AUTO   Number of parallel tree search walkers sharing the threads (default: 1)" << endl
     << "  -g FILE              (Multifurcating) topological constraint tree file" << endl
     << "  --fast               Fast search to resemble FastTree" << endl
     << "  --polytomy           Collapse near-zero branches into polytomy" << endl
@@ -5749,6 +5807,8 @@ void usage_iqtree(char* argv[], bool full_command) {
     << endl << "ANCESTRAL STATE RECONSTRUCTION:" << endl
     << "  --ancestral          Ancestral state reconstruction by empirical Bayes" << endl
     << "  --asr-min NUM        Min probability of ancestral state (default: equil freq)" << endl
+    << "  --asr-bin            Write per-pattern ancestral states to compressed .statebin" << endl
+    << "  --asr-bin2txt FILE   Convert .statebin FILE into tab-separated .state format" << endl
 
     << endl << "TEST OF SYMMETRY:" << endl
     << "  --symtest               Perform three tests of symmetry" << endl
@@ -710,6 +710,17 @@ public:
 	 */
 	bool speednni;
 
+	/**
+	 *  after applying NNIs, only optimize branch lengths around the NNIs instead of all branches
+	 */
+	bool local_nni_brlen;
+
+	/**
+	 *  number of independent walkers of the tree search sharing the candidate set,
+	 *  0 to choose from the number of threads and patterns, 1 for the standard search
+	 */
+	int num_walkers;
+
 
 	/**
 	 *  portion of NNI used for perturbing the tree
@@ -1306,6 +1317,12 @@ public:
      */
     bool root_test;
 
+    /**
+     number of root positions with the best first-pass likelihoods to fully optimize
+     in the root test, 0 to fully optimize all root positions
+     */
+    int root_test_top;
+
     /**
             min branch length, used to create random tree/network
      */
@@ -1842,6 +1859,15 @@ public:
     /** minimum probability to assign an ancestral state */
     double min_ancestral_prob;
 
+    /**
+        true to write marginal ancestral states per pattern into a compressed binary
+        .statebin file (with site-to-pattern index) instead of the tab-separated .state file
+    */
+    bool print_ancestral_binary;
+
+    /** binary ancestral state file (.statebin) to convert into the tab-separated .state format */
+    char *ancestral_bin_file;
+
     /**
         0: print nothing
         1: print site state frequency vectors
@@ -2125,6 +2151,9 @@ public:
     /** TRUE to compress big file using zlib */
     bool do_compression;
 
+    /** TRUE to write big output files by a background writer thread */
+    bool async_output;
+
     /**
             number of bootstrap samples for AvH curiosity
      */